@@ -0,0 +1,186 @@
+/*** includes ***/
+
+// Feature test macros (portability): https://www.gnu.org/software/libc/manual/html_node/Feature-Test-Macros.html
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../lib/editor.h"
+
+// Micro-benchmarks of `libeditor` hot paths on a generated C file: `bench [lines]`
+
+#define BENCH_SCREENROWS 50
+#define BENCH_SCREENCOLS 160
+
+/*** timing ***/
+
+double benchNow(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+void benchReport(const char *name, double start, long ops) {
+  double ms = benchNow() - start;
+  printf("%-28s %10.2f ms  %10.1f ns/op\n", name, ms, ops ? ms * 1e6 / ops : 0.0);
+}
+
+/*** fixtures ***/
+
+// Writes `lines` lines of C-like source (with tabs, strings and comments) to a temporary file
+char *benchWriteFixture(int lines) {
+  static char path[] = "/tmp/editor-bench-XXXXXX.c";
+  int fd = mkstemps(path, 2);
+  if (fd == -1) return NULL;
+
+  FILE *fp = fdopen(fd, "w");
+  for (int j = 0; j < lines; j++) {
+    switch (j % 8) {
+      // clang-format off
+      case 0: fprintf(fp, "/* block %d\n", j); break;
+      case 1: fprintf(fp, " * spans two lines */\n"); break;
+      case 2: fprintf(fp, "static int function_%d(int a, char *s) {\n", j); break;
+      case 3: fprintf(fp, "\tif (a > %d) return strlen(\"needle %d\");\n", j, j); break;
+      case 4: fprintf(fp, "\tdouble x = %d.5 * a; // trailing comment\n", j); break;
+      case 5: fprintf(fp, "\twhile (*s) s++;\n"); break;
+      case 6: fprintf(fp, "\treturn (int)x;\n"); break;
+      case 7: fprintf(fp, "}\n"); break;
+      // clang-format on
+    }
+  }
+  fclose(fp);
+
+  return path;
+}
+
+/*** main ***/
+
+int main(int argc, char *argv[]) {
+  int lines = argc >= 2 ? atoi(argv[1]) : 1000000;
+  if (lines <= 0) lines = 1000000;
+
+  char *path = benchWriteFixture(lines);
+  if (path == NULL) {
+    perror("mkstemps");
+    return 1;
+  }
+
+  struct editorConfig E;
+  editorInit(&E, BENCH_SCREENROWS, BENCH_SCREENCOLS);
+  printf("%d lines\n", lines);
+
+  struct editorBuffer *B = E.buf;
+  double start = benchNow();
+  if (editorOpen(B, path) == -1) {
+    perror("editorOpen");
+    return 1;
+  }
+  benchReport("editorOpen", start, B->numrows);
+
+  start = benchNow();
+  for (int j = 0; j < B->numrows; j++) editorUpdateRow(B, &B->row[j]);
+  benchReport("editorUpdateRow (all rows)", start, B->numrows);
+
+  // Typing in the middle of the file: insert and delete a character per row in a window
+  int window = B->numrows < 10000 ? B->numrows : 10000;
+  start = benchNow();
+  for (int j = 0; j < window; j++) {
+    erow *row = &B->row[B->numrows / 2 + j - window / 2];
+    editorRowInsertChar(B, row, 1, 'x');
+    editorRowDelChar(B, row, 1);
+  }
+  benchReport("insert+delete char", start, window * 2L);
+
+  // The same rows as one block: each operation is a single splice of the row array
+  B->cy = B->numrows / 2 - window / 2;
+  B->cx = 0;
+  editorSelectionStart(&E);
+  B->cy += window;
+  start = benchNow();
+  editorSelectionIndent(&E, 1);
+  editorSelectionIndent(&E, -1);
+  benchReport("indent+unindent block", start, window * 2L);
+
+  start = benchNow();
+  editorSelectionCut(&E);
+  editorClipboardPaste(&E);
+  benchReport("cut+paste block", start, window * 2L);
+  editorClipboardClear(&E);
+
+  // Each search steps to the next match, so this walks `searches` matches from the top
+  int searches = 1000;
+  start = benchNow();
+  editorFindCallback(&E, "needle", 'n');
+  for (int j = 1; j < searches; j++) editorFindCallback(&E, "needle", ARROW_DOWN);
+  editorFindCallback(&E, "needle", '\r');
+  benchReport("editorFindCallback (step)", start, searches);
+
+  start = benchNow();
+  editorFindCallback(&E, "no such text", 'n');
+  editorFindCallback(&E, "no such text", '\r');
+  benchReport("editorFindCallback (miss)", start, B->numrows);
+
+  // Every match replaced and put back, each direction one pass over the rows
+  char err[80];
+  start = benchNow();
+  int replaced = editorReplaceAll(B, "needle", "pin", 0, err, sizeof(err));
+  replaced += editorReplaceAll(B, "pin", "needle", 0, err, sizeof(err));
+  benchReport("replace all (literal)", start, replaced);
+
+  start = benchNow();
+  replaced = editorReplaceAll(B, "ne(e)dle", "n\\1\\1dle", 1, err, sizeof(err));
+  benchReport("replace all (regex)", start, replaced);
+
+  int frames = 1000;
+  start = benchNow();
+  for (int j = 0; j < frames; j++) {
+    struct abuf ab = ABUF_INIT;
+    B->cy = (long)j * B->numrows / frames;
+    editorRenderScreen(&E, &ab);
+    abFree(&ab);
+  }
+  benchReport("editorRenderScreen", start, frames);
+
+  // Stepping down a line at a time from the bottom of the screen, as with held ARROW_DOWN
+  long bytes = 0;
+  B->cy = B->rowoff + BENCH_SCREENROWS;
+  start = benchNow();
+  for (int j = 0; j < frames; j++) {
+    struct abuf ab = ABUF_INIT;
+    B->cy++;
+    editorRenderScreen(&E, &ab);
+    bytes += ab.len;
+    abFree(&ab);
+  }
+  benchReport("editorRenderScreen (scroll)", start, frames);
+  printf("scroll: %.0f bytes/frame\n", (double)bytes / frames);
+
+  start = benchNow();
+  size_t len;
+  char *buf = editorRowsToString(B, &len);
+  free(buf);
+  benchReport("editorRowsToString", start, B->numrows);
+
+  // A second buffer of the same file; switching back and forth must not touch its rows
+  editorOpen(editorBufferNew(&E), path);
+  int switches = 1000000;
+  start = benchNow();
+  for (int j = 0; j < switches; j++) editorBufferSwitch(&E, j & 1 ? 0 : 1);
+  benchReport("editorBufferSwitch", start, switches);
+
+  struct editorPoolStats st;
+  poolStats(&E.pool, &st);
+  printf("pool: %zu slabs, %.1f MB in slabs, %.1f MB large, %.1f MB size-class slack, %.1f MB fragmented\n",
+         st.slabs, st.slab_bytes / 1e6, st.large_bytes / 1e6, (st.in_use - st.requested) / 1e6,
+         st.fragmented / 1e6);
+
+  editorFree(&E);
+  unlink(path);
+  return 0;
+}
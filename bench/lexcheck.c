@@ -0,0 +1,339 @@
+/*** includes ***/
+
+// Feature test macros (portability): https://www.gnu.org/software/libc/manual/html_node/Feature-Test-Macros.html
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+
+#include "../lib/editor.h"
+
+// Checks the compiled lexers against a character-by-character highlighter on random rows:
+// `lexcheck [syntax dir] [rows]`. The built-in C filetype and every definition in the directory
+// are checked as compiled, and the definitions also as read back from their `.lex` cache.
+
+#define CHECK_MAX_ROW 64
+#define CHECK_MAX_REPORTS 5
+
+/*** reference highlighter ***/
+
+// Whether `text` (of `len` bytes) starts with the `wlen` bytes of `word`
+static int refStartsWith(const char *text, int len, const char *word, int wlen, int nocase) {
+  if (wlen > len) return 0;
+  return nocase ? !strncasecmp(text, word, wlen) : !memcmp(text, word, wlen);
+}
+
+// Highlights `text` one byte at a time, the way rows were before lexers were compiled. Returns
+// whether the row ends inside a multi-line comment.
+static int refHighlight(struct editorSyntax *syntax, const char *text, int len, unsigned char *hl, int in_comment) {
+  char **keywords = syntax->keywords;
+  char *scs = syntax->singleline_comment_start;
+  char *mcs = syntax->multiline_comment_start;
+  char *mce = syntax->multiline_comment_end;
+  const char *quotes = syntax->quotes ? syntax->quotes : "\"'";
+  int nocase = syntax->flags & HL_IGNORE_CASE;
+
+  int scs_len = scs ? strlen(scs) : 0;
+  int mcs_len = mcs && mce && *mce ? strlen(mcs) : 0;
+  int mce_len = mcs_len ? strlen(mce) : 0;
+
+  memset(hl, HL_NORMAL, len);
+  int prev_sep = 1;
+  int in_string = 0;
+
+  int i = 0;
+  while (i < len) {
+    int c = (unsigned char)text[i];
+    int prev_hl = i > 0 ? hl[i - 1] : HL_NORMAL;
+
+    if (scs_len && !in_string && !in_comment && refStartsWith(&text[i], len - i, scs, scs_len, 0)) {
+      memset(&hl[i], HL_COMMENT, len - i);
+      break;
+    }
+
+    if (mcs_len && !in_string) {
+      if (in_comment) {
+        hl[i] = HL_MLCOMMENT;
+        if (refStartsWith(&text[i], len - i, mce, mce_len, 0)) {
+          memset(&hl[i], HL_MLCOMMENT, mce_len);
+          i += mce_len;
+          in_comment = 0;
+          prev_sep = 1;
+        } else {
+          i++;
+        }
+        continue;
+      } else if (refStartsWith(&text[i], len - i, mcs, mcs_len, 0)) {
+        memset(&hl[i], HL_MLCOMMENT, mcs_len);
+        i += mcs_len;
+        in_comment = 1;
+        continue;
+      }
+    }
+
+    if (syntax->flags & HL_HIGHLIGHT_STRINGS) {
+      if (in_string) {
+        hl[i] = HL_STRING;
+        if (c == '\\' && i + 1 < len) {
+          hl[i + 1] = HL_STRING;
+          i += 2;
+          continue;
+        }
+        if (c == in_string) in_string = 0;
+        i++;
+        prev_sep = 1;
+        continue;
+      } else if (c && strchr(quotes, c)) {
+        in_string = c;
+        hl[i] = HL_STRING;
+        i++;
+        continue;
+      }
+    }
+
+    if ((syntax->flags & HL_HIGHLIGHT_NUMBERS) &&
+        ((isdigit(c) && (prev_sep || prev_hl == HL_NUMBER)) || (c == '.' && prev_hl == HL_NUMBER))) {
+      hl[i] = HL_NUMBER;
+      i++;
+      prev_sep = 0;
+      continue;
+    }
+
+    if (prev_sep) {
+      int j;
+      for (j = 0; keywords[j]; j++) {
+        int klen = strlen(keywords[j]);
+        int kw2 = keywords[j][klen - 1] == '|';
+        if (kw2) klen--;
+
+        if (refStartsWith(&text[i], len - i, keywords[j], klen, nocase) &&
+            (i + klen == len || is_separator((unsigned char)text[i + klen]))) {
+          memset(&hl[i], kw2 ? HL_KEYWORD2 : HL_KEYWORD1, klen);
+          i += klen;
+          break;
+        }
+      }
+      if (keywords[j] != NULL) {
+        prev_sep = 0;
+        continue;
+      }
+    }
+
+    prev_sep = is_separator(c);
+    i++;
+  }
+
+  return in_comment;
+}
+
+/*** random rows ***/
+
+static unsigned long long checkSeed = 88172645463325252ull;
+
+static unsigned int checkRandom(unsigned int n) {
+  checkSeed ^= checkSeed << 13;
+  checkSeed ^= checkSeed >> 7;
+  checkSeed ^= checkSeed << 17;
+  return checkSeed % n;
+}
+
+// Appends a random piece of `syntax` (a keyword, delimiter, quote, number, separator or any
+// byte) to `row`, up to `CHECK_MAX_ROW` bytes
+static void checkAppendPiece(struct editorSyntax *syntax, char *row, int *len) {
+  static const char *pieces[] = {" ", "\t", "\\", ".", "0", "7", "1.5", "x", "_a", ",", "(", ")",
+                                 "+", "-", "/", "*", "=", "~", "%", "<", ">", "[", "]", ";", "#"};
+  int npieces = sizeof(pieces) / sizeof(pieces[0]);
+  int nkeywords = 0;
+  while (syntax->keywords[nkeywords]) nkeywords++;
+
+  char byte[2] = {1 + checkRandom(255), '\0'};
+  const char *quotes = syntax->quotes ? syntax->quotes : "\"'";
+  char quote[2] = {quotes[checkRandom(strlen(quotes))], '\0'};
+  char word[CHECK_MAX_ROW + 1] = "";
+  const char *piece;
+
+  switch (checkRandom(8)) {
+    case 0:
+    case 1:
+      if (nkeywords == 0) {
+        piece = "kw";
+        break;
+      }
+      // Keywords in any case, so `ignorecase` is exercised too
+      snprintf(word, sizeof(word), "%s", syntax->keywords[checkRandom(nkeywords)]);
+      if (word[strlen(word) - 1] == '|') word[strlen(word) - 1] = '\0';
+      for (char *p = word; *p; p++) {
+        if (checkRandom(4) == 0) *p = isupper((unsigned char)*p) ? tolower(*p) : toupper(*p);
+      }
+      piece = word;
+      break;
+    case 2:
+      piece = checkRandom(2) ? syntax->singleline_comment_start : syntax->multiline_comment_start;
+      break;
+    case 3:
+      piece = syntax->multiline_comment_end;
+      break;
+    case 4:
+      piece = quote;
+      break;
+    case 5:
+      piece = byte;
+      break;
+    default:
+      piece = pieces[checkRandom(npieces)];
+      break;
+  }
+  if (piece == NULL) return;
+
+  int n = strlen(piece);
+  if (*len + n > CHECK_MAX_ROW) n = CHECK_MAX_ROW - *len;
+  memcpy(&row[*len], piece, n);
+  *len += n;
+}
+
+/*** checks ***/
+
+static void checkPrintRow(const char *label, const unsigned char *hl, int len) {
+  printf("  %-10s ", label);
+  for (int j = 0; j < len; j++) putchar('0' + hl[j]);
+  putchar('\n');
+}
+
+// Highlights `rows` random rows of `syntax` with lexer `X`, each row starting in the comment
+// state the one before it ended in, and compares them with `refHighlight()`. Returns the number
+// of rows that differ.
+static int checkLexer(struct editorPool *pool, struct editorSyntax *syntax, struct editorLexer *X,
+                      const char *source, int rows) {
+  struct editorLexer *lexer = syntax->lexer;
+  syntax->lexer = X;
+
+  char text[CHECK_MAX_ROW + 1];
+  unsigned char want[CHECK_MAX_ROW], got[CHECK_MAX_ROW];
+  int want_comment = 0, got_comment = 0, bad = 0;
+
+  for (int y = 0; y < rows; y++) {
+    int len = 0;
+    int pieces = checkRandom(12);
+    for (int j = 0; j < pieces; j++) checkAppendPiece(syntax, text, &len);
+    text[len] = '\0';
+
+    erow row = {0};
+    row.chars = row.render = text;
+    row.size = row.rsize = len;
+    row.shared = 1;
+
+    int in_comment = want_comment;
+    want_comment = refHighlight(syntax, text, len, want, in_comment);
+    got_comment = editorHighlightRow(pool, syntax, &row, got_comment);
+
+    memset(got, HL_NORMAL, len);
+    for (int j = 0; j < row.nhl; j++) memset(&got[row.hl[j].start], row.hl[j].hl, row.hl[j].len);
+    poolFree(pool, row.hl);
+
+    if (memcmp(want, got, len) == 0 && want_comment == got_comment) continue;
+    if (bad++ < CHECK_MAX_REPORTS) {
+      printf("%s (%s): row %d differs, starting %s a comment\n", syntax->filetype, source, y,
+             in_comment ? "inside" : "outside");
+      printf("  %-10s %s\n", "text", text);
+      checkPrintRow("expected", want, len);
+      checkPrintRow("lexer", got, len);
+    }
+    got_comment = want_comment;  // Carry on from the same state
+  }
+
+  printf("%-10s %-9s %d rows, %d differ\n", syntax->filetype, source, rows, bad);
+  syntax->lexer = lexer;
+  return bad;
+}
+
+// Selects the filetype of `name` for `B`, as opening a file of that name would
+static struct editorSyntax *checkSyntaxFor(struct editorBuffer *B, const char *name) {
+  free(B->filename);
+  B->filename = strdup(name);
+  editorSelectSyntaxHighlight(B);
+  return B->syntax;
+}
+
+// A file name the definition at `path` matches: its first `match` word, after `x` if it is an
+// extension
+static int checkMatchName(const char *path, char *name, size_t size) {
+  FILE *fp = fopen(path, "r");
+  if (fp == NULL) return -1;
+
+  char line[256], word[128];
+  int found = 0;
+  while (!found && fgets(line, sizeof(line), fp)) {
+    found = sscanf(line, "match %127s", word) == 1;
+  }
+  fclose(fp);
+  if (!found) return -1;
+
+  snprintf(name, size, "%s%s", word[0] == '.' ? "x" : "", word);
+  return 0;
+}
+
+static int checkFileFilter(const struct dirent *d) {
+  const char *dot = strrchr(d->d_name, '.');
+  return d->d_name[0] != '.' && dot && !strcmp(dot, ".syntax");
+}
+
+/*** main ***/
+
+int main(int argc, char *argv[]) {
+  const char *dir = argc >= 2 ? argv[1] : "syntax";
+  int rows = argc >= 3 ? atoi(argv[2]) : 200000;
+  if (rows <= 0) rows = 200000;
+
+  struct editorConfig E;
+  editorInit(&E, 24, 80);
+  struct editorBuffer *B = E.buf;
+
+  // Loading compiles each definition and writes its cache, unless a current one is there
+  char err[80];
+  if (editorSyntaxLoad(dir, err, sizeof(err)) == -1) {
+    fprintf(stderr, "%s: %s\n", dir, err);
+    return 1;
+  }
+
+  int bad = 0;
+  struct editorSyntax *syntax = checkSyntaxFor(B, "x.c");
+  if (syntax) bad += checkLexer(B->pool, syntax, syntax->lexer, "compiled", rows);
+
+  struct dirent **names;
+  int n = scandir(dir, &names, checkFileFilter, alphasort);
+  for (int j = 0; j < n; j++) {
+    char path[4096], name[256];
+    snprintf(path, sizeof(path), "%s/%s", dir, names[j]->d_name);
+    free(names[j]);
+
+    struct stat st;
+    if (checkMatchName(path, name, sizeof(name)) == -1 || stat(path, &st) == -1 ||
+        (syntax = checkSyntaxFor(B, name)) == NULL) {
+      printf("%-10s skipped\n", path);
+      continue;
+    }
+
+    struct editorLexer *X = editorLexerCompile(syntax, err, sizeof(err));
+    bad += checkLexer(B->pool, syntax, X, "compiled", rows);
+    editorLexerFree(X);
+
+    X = editorLexerLoad(path, &st);
+    if (X == NULL) {
+      printf("%-10s %-9s none\n", syntax->filetype, "cached");
+      continue;
+    }
+    bad += checkLexer(B->pool, syntax, X, "cached", rows);
+    editorLexerFree(X);
+  }
+  if (n != -1) free(names);
+
+  editorFree(&E);
+  return bad ? 1 : 0;
+}
@@ -8,120 +8,40 @@
 #include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
 #include <stdio.h>
-#include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
-#include <sys/types.h>
 #include <termios.h>
-#include <time.h>
 #include <unistd.h>
 
+#include "lib/editor.h"
+
+// Terminal front end: owns the tty and key handling, and drives a `libeditor` context
+
 /*** defines ***/
 
-#define EDITOR_VERSION "0.0.1"
-#define EDITOR_TAB_STOP 8
-#define EDITOR_QUIT_TIMES 3
-
-#define CTRL_KEY(k) ((k) & 0x1f)
-
-enum editorKey {
-  BACKSPACE = 127,
-  ARROW_LEFT = 1000,
-  ARROW_RIGHT,
-  ARROW_UP,
-  ARROW_DOWN,
-  DEL_KEY,
-  HOME_KEY,
-  END_KEY,
-  PAGE_UP,
-  PAGE_DOWN,
-};
-
-enum editorHighlight {
-  HL_NORMAL = 0,
-  HL_COMMENT,
-  HL_MLCOMMENT,
-  HL_KEYWORD1,
-  HL_KEYWORD2,
-  HL_STRING,
-  HL_NUMBER,
-  HL_MATCH,
-};
-
-#define HL_HIGHLIGHT_NUMBERS (1 << 0)
-#define HL_HIGHLIGHT_STRINGS (1 << 1)
+#define EDITOR_MACRO_MAX_RUNS 1000000  // Replays repeated until a search fails stop here regardless
+
+// Where `*.syntax` filetype definitions are read from, unless `EDITOR_SYNTAX` names a directory
+#ifndef EDITOR_SYNTAX_DIR
+#define EDITOR_SYNTAX_DIR "syntax"
+#endif
 
 /*** data ***/
 
-struct editorSyntax {
-  char *filetype;
-  char **filematch;
-  char **keywords;
-  char *singleline_comment_start;  // To disable, set to NULL or ""
-  char *multiline_comment_start;
-  char *multiline_comment_end;
-  int flags;
-};
-
-typedef struct erow {
-  int idx;
-  int size;
-  char *chars;
-  int rsize;
-  char *render;
-  unsigned char *hl;
-  int hl_open_comment;
-} erow;
-
-struct editorConfig {
-  int cx, cy;
-  int rx;
-  int rowoff, coloff;
-  int screenrows, screencols;
-  int numrows;
-  erow *row;
-  int dirty;
-  char *filename;
-  char statusmsg[80];
-  time_t statusmsg_time;
-  struct editorSyntax *syntax;
-  struct termios orig_termios;
-};
-
-struct editorConfig E;
-
-/*** filetypes ***/
-
-char *C_HL_extensions[] = {".c", ".h", ".cpp", NULL};
-
-// Secondary keywords end in |
-char *C_HL_keywords[] = {
-    "switch", "if", "while", "for", "break", "continue", "return", "else",
-    "struct", "union", "typedef", "static", "enum", "class", "case",
-    "int|", "long|", "double|", "float|", "char|", "unsigned|", "signed|",
-    "void|", NULL};
-
-/* Highlight database */
-struct editorSyntax HLDB[] = {
-    {
-        "c",
-        C_HL_extensions,
-        C_HL_keywords,
-        "//",
-        "/*",
-        "*/",
-        HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS,
-    }};
-
-#define HLDB_ENTRIES (sizeof(HLDB) / sizeof(HLDB[0]))
+struct termios orig_termios;
 
 /*** prototypes ***/
 
-void editorSetStatusMessage(const char *fmt, ...);
-void editorRefreshScreen(void);
-char *editorPrompt(char *prompt, void (*callback)(char *, int));
+void editorRefreshScreen(struct editorConfig *E);
+char *editorPrompt(struct editorConfig *E, char *prompt, void (*callback)(struct editorConfig *, char *, int));
+char *editorPromptText(struct editorConfig *E, char *prompt, void (*callback)(struct editorConfig *, char *, int),
+                       int allow_empty);
+int editorReadOnly(struct editorConfig *E);
+void editorProcessKeypress(struct editorConfig *E);
 
 /*** terminal ***/
 
@@ -134,15 +54,15 @@ void die(const char *s) {
 }
 
 void disableRawMode(void) {
-  if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &E.orig_termios) == -1) die("tcsetattr");
+  if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &orig_termios) == -1) die("tcsetattr");
 }
 
 void enableRawMode(void) {
-  if (tcgetattr(STDIN_FILENO, &E.orig_termios) == -1) die("tcgetattr");
+  if (tcgetattr(STDIN_FILENO, &orig_termios) == -1) die("tcgetattr");
 
   atexit(disableRawMode);
 
-  struct termios raw = E.orig_termios;
+  struct termios raw = orig_termios;
   raw.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
   raw.c_oflag &= ~(OPOST);
   raw.c_cflag |= (CS8);
@@ -153,12 +73,24 @@ void enableRawMode(void) {
   if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) == -1) die("tcsetattr");
 }
 
-int editorReadKey(void) {
+static int editorReadTerminalKey(struct editorConfig *E) {
   int nread;
   char c;
 
-  while ((nread = read(STDIN_FILENO, &c, 1)) != 1) {
+  int busy = 0;
+  while (1) {
+    // While a file is loading, keep feeding it rows instead of sleeping out the read timeout, and
+    // only wait for more while none are ready
+    struct pollfd pfd = {.fd = STDIN_FILENO, .events = POLLIN};
+    if (editorLoading(E) && poll(&pfd, 1, busy ? 0 : 10) == 0) {
+      busy = editorPoll(E);
+      if (busy) editorRefreshScreen(E);
+      continue;
+    }
+
+    if ((nread = read(STDIN_FILENO, &c, 1)) == 1) break;
     if (nread == -1 && errno != EAGAIN) die("read");
+    if (editorIdle(E)) editorRefreshScreen(E);  // No key within the read timeout
   }
 
   if (c == '\x1b') {
@@ -193,6 +125,7 @@ int editorReadKey(void) {
           case 'D': return ARROW_LEFT;
           case 'H': return HOME_KEY;
           case 'F': return END_KEY;
+          case 'Z': return SHIFT_TAB;
             // clang-format on
         }
       }
@@ -210,6 +143,16 @@ int editorReadKey(void) {
   }
 }
 
+// The next key: from the terminal, or from the macro being replayed. Keys from the terminal are
+// recorded into the macro while recording.
+int editorReadKey(struct editorConfig *E) {
+  if (E->macro.playing) return editorMacroNext(E);
+
+  int c = editorReadTerminalKey(E);
+  editorMacroRecord(E, c);
+  return c;
+}
+
 int getCursorPosition(int *rows, int *cols) {
   char buf[32];
   unsigned int i = 0;
@@ -244,710 +187,284 @@ int getWindowSize(int *rows, int *cols) {
   }
 }
 
-/*** syntax highlighting ***/
-
-int is_separator(int c) {
-  return isspace(c) || c == '\0' || strchr(",.()+-/*=~%<>[];", c) != NULL;
-}
-
-void editorUpdateSyntax(erow *row) {
-  row->hl = realloc(row->hl, row->rsize);
-  memset(row->hl, HL_NORMAL, row->rsize);
-
-  if (E.syntax == NULL) return;
-
-  char **keywords = E.syntax->keywords;
-
-  char *scs = E.syntax->singleline_comment_start;
-  char *mcs = E.syntax->multiline_comment_start;
-  char *mce = E.syntax->multiline_comment_end;
-
-  int scs_len = scs ? strlen(scs) : 0;
-  int mcs_len = mcs ? strlen(mcs) : 0;
-  int mce_len = mce ? strlen(mce) : 0;
-
-  int prev_sep = 1;  // true
-  int in_string = 0;
-  int in_comment = (row->idx > 0 && E.row[row->idx - 1].hl_open_comment);
-
-  int i = 0;
-  while (i < row->rsize) {
-    char c = row->render[i];
-    unsigned char prev_hl = (i > 0) ? row->hl[i - 1] : HL_NORMAL;
-
-    if (scs_len && !in_string && !in_comment) {
-      if (!strncmp(&row->render[i], scs, scs_len)) {
-        memset(&row->hl[i], HL_COMMENT, row->rsize - i);
-        break;
-      }
-    }
+/*** output ***/
 
-    if (mcs_len && mce_len && !in_string) {
-      if (in_comment) {
-        row->hl[i] = HL_MLCOMMENT;
-
-        if (!strncmp(&row->render[i], mce, mce_len)) {
-          memset(&row->hl[i], HL_MLCOMMENT, mce_len);
-          i += mce_len;
-          in_comment = 0;
-          prev_sep = 1;
-          continue;
-        } else {
-          i++;
-          continue;
-        }
-      } else if (!strncmp(&row->render[i], mcs, mcs_len)) {
-        memset(&row->hl[i], HL_MLCOMMENT, mcs_len);
-        i += mcs_len;
-        in_comment = 1;
-        continue;
-      }
-    }
+// Only the state a macro replay ends in is drawn
+void editorRefreshScreen(struct editorConfig *E) {
+  if (E->macro.playing) return;
+  TRACE_BEGIN("editorRefreshScreen");
+  struct abuf ab = ABUF_INIT;
 
-    if (E.syntax->flags & HL_HIGHLIGHT_STRINGS) {
-      if (in_string) {
-        row->hl[i] = HL_STRING;
+  editorRenderScreen(E, &ab);
 
-        if (c == '\\' && i + 1 < row->rsize) {
-          row->hl[i + 1] = HL_STRING;
-          i += 2;
-          continue;
-        }
+  write(STDOUT_FILENO, ab.b, ab.len);
+  abFree(&ab);
+  TRACE_END("editorRefreshScreen");
+}
 
-        if (c == in_string) in_string = 0;  // Closing quote; string ends
-        i++;
-        prev_sep = 1;
-        continue;
-      } else {
-        if (c == '"' || c == '\'') {
-          in_string = c;
-          row->hl[i] = HL_STRING;
-          i++;
-          continue;
-        }
-      }
-    }
+/*** file i/o ***/
 
-    if (E.syntax->flags & HL_HIGHLIGHT_NUMBERS) {
-      if ((isdigit(c) && (prev_sep || prev_hl == HL_NUMBER)) ||
-          (c == '.' && prev_hl == HL_NUMBER)) {
-        row->hl[i] = HL_NUMBER;
-        i++;
-        prev_sep = 0;  // false
-        continue;
-      }
-    }
+void editorSaveFile(struct editorConfig *E) {
+  if (E->buf->filename == NULL) {
+    char *filename = editorPrompt(E, "Save as: %s (ESC to cancel)", NULL);
 
-    if (prev_sep) {
-      int j;
-      for (j = 0; keywords[j]; j++) {
-        int klen = strlen(keywords[j]);
-        int kw2 = keywords[j][klen - 1] == '|';
-        if (kw2) klen--;
-        if (!strncmp(&row->render[i], keywords[j], klen) && is_separator(row->render[i + klen])) {
-          memset(&row->hl[i], kw2 ? HL_KEYWORD2 : HL_KEYWORD1, klen);
-          i += klen;
-          break;
-        }
-      }
-      if (keywords[j] != NULL) {
-        prev_sep = 0;
-        continue;
-      }
+    if (filename == NULL) {
+      editorSetStatusMessage(E, "Save aborted");
+      return;
     }
 
-    prev_sep = is_separator(c);
-    i++;
+    editorWatchRemove(E, E->buf);
+    editorSetFilename(E->buf, filename);
+    free(filename);
   }
 
-  int changed = (row->hl_open_comment != in_comment);
-  row->hl_open_comment = in_comment;
-  if (changed && row->idx + 1 < E.numrows) editorUpdateSyntax(&E.row[row->idx + 1]);
-}
-
-int editorSyntaxToColor(int hl) {
-  switch (hl) {
-      // clang-format off
-    case HL_COMMENT:
-    case HL_MLCOMMENT: return 36;  // Cyan
-    case HL_KEYWORD1:  return 33;  // Yellow
-    case HL_KEYWORD2:  return 32;  // Green
-    case HL_STRING:    return 35;  // Magenta
-    case HL_NUMBER:    return 31;  // Red
-    case HL_MATCH:     return 34;  // Blue
-    default:           return 37;  // White
-      // clang-format on
-  }
+  editorSave(E);
 }
 
-void editorSelectSyntaxHighlight(void) {
-  E.syntax = NULL;
-
-  if (E.filename == NULL) return;
-  char *ext = strrchr(E.filename, '.');  // Pointer to last occurrence in string
+/*** buffers ***/
 
-  for (unsigned int j = 0; j < HLDB_ENTRIES; j++) {
-    struct editorSyntax *s = &HLDB[j];
-    unsigned int i = 0;
+void editorOpenFile(struct editorConfig *E) {
+  char *filename = editorPrompt(E, "Open: %s (ESC to cancel)", NULL);
+  if (filename == NULL) return;
 
-    while (s->filematch[i]) {
-      int is_ext = (s->filematch[i][0] == '.');
-
-      // `strcmp()` returns 0 if strings are equal
-      if ((is_ext && ext && !strcmp(ext, s->filematch[i])) ||
-          (!is_ext && strstr(E.filename, s->filematch[i]))) {
-        E.syntax = s;
-
-        for (int filerow = 0; filerow < E.numrows; filerow++) {
-          editorUpdateSyntax(&E.row[filerow]);
-        }
-
-        return;
-      }
-      i++;
+  for (int j = 0; j < E->numbuffers; j++) {
+    if (E->buffers[j]->filename && !strcmp(E->buffers[j]->filename, filename)) {
+      editorBufferSwitch(E, j);
+      free(filename);
+      return;
     }
   }
-}
-
-/*** row operations ***/
-
-int editorRowCxToRx(erow *row, int cx) {
-  int rx = 0;
-  for (int j = 0; j < cx; j++) {
-    if (row->chars[j] == '\t') rx += (EDITOR_TAB_STOP - 1) - (rx % EDITOR_TAB_STOP);
-    rx++;
-  }
-
-  return rx;
-}
-
-int editorRowRxToCx(erow *row, int rx) {
-  int cur_rx = 0;
-  int cx;
 
-  for (cx = 0; cx < row->size; cx++) {
-    if (row->chars[cx] == '\t') cur_rx += (EDITOR_TAB_STOP - 1) - (cur_rx % EDITOR_TAB_STOP);
-    cur_rx++;
-    if (cur_rx > rx) return cx;
+  // An untouched scratch buffer is reused rather than left behind in the list
+  struct editorBuffer *B = E->buf;
+  if (B->filename != NULL || B->numrows != 0 || B->dirty) {
+    editorBufferNew(E);
+    editorBufferSwitch(E, E->numbuffers - 1);
+    B = E->buf;
   }
-  return cx;
-}
-
-void editorUpdateRow(erow *row) {
-  int tabs = 0;
 
-  int j;
-  for (j = 0; j < row->size; j++) {
-    if (row->chars[j] == '\t') tabs++;  // Count tabs to calculate memory to allocate for `render`
-  }
-
-  free(row->render);
-  // `row->size` already counts 1 per tab; multiply tab count by 7 and add to get maximum row memory
-  row->render = malloc(row->size + tabs * (EDITOR_TAB_STOP - 1) + 1);
-
-  int idx = 0;
-  for (j = 0; j < row->size; j++) {
-    if (row->chars[j] == '\t') {
-      row->render[idx++] = ' ';
-      // Append spaces until we reach a tab stop (column divisible by 8)
-      while (idx % EDITOR_TAB_STOP != 0) row->render[idx++] = ' ';
+  if (editorOpenAsync(B, filename) == -1) {
+    if (errno == ENOENT) {
+      editorSetStatusMessage(E, "New file: %s", filename);
     } else {
-      row->render[idx++] = row->chars[j];
+      editorSetStatusMessage(E, "Can't open %s: %s", filename, strerror(errno));
+      editorBufferClose(E, E->current);
     }
   }
-
-  row->render[idx] = '\0';
-  row->rsize = idx;
-
-  editorUpdateSyntax(row);
-}
-
-void editorInsertRow(int at, char *s, size_t len) {
-  if (at < 0 || at > E.numrows) return;
-
-  E.row = realloc(E.row, sizeof(erow) * (E.numrows + 1));
-  memmove(&E.row[at + 1], &E.row[at], sizeof(erow) * (E.numrows - at));
-
-  for (int j = at + 1; j <= E.numrows; j++) E.row[j].idx++;
-
-  E.row[at].idx = at;
-
-  E.row[at].size = len;
-  E.row[at].chars = malloc(len + 1);
-  memcpy(E.row[at].chars, s, len);
-  E.row[at].chars[len] = '\0';
-
-  E.row[at].rsize = 0;
-  E.row[at].render = NULL;
-  E.row[at].hl = NULL;
-  E.row[at].hl_open_comment = 0;
-
-  editorUpdateRow(&E.row[at]);
-
-  E.numrows++;
-  E.dirty++;
-}
-
-void editorFreeRow(erow *row) {
-  free(row->render);
-  free(row->chars);
-  free(row->hl);
+  free(filename);
 }
 
-void editorDelRow(int at) {
-  if (at < 0 || at >= E.numrows) return;
-  editorFreeRow(&E.row[at]);
-  memmove(&E.row[at], &E.row[at + 1], sizeof(erow) * (E.numrows - at - 1));
+void editorSwitchBuffer(struct editorConfig *E) {
+  char list[64];
+  int len = 0;
 
-  for (int j = at; j < E.numrows - 1; j++) E.row[j].idx--;
+  for (int j = 0; j < E->numbuffers && len < (int)sizeof(list) - 1; j++) {
+    struct editorBuffer *B = E->buffers[j];
+    char *name = B->filename ? B->filename : "[No Name]";
+    char *slash = strrchr(name, '/');
+    if (slash) name = slash + 1;
 
-  E.numrows--;
-  E.dirty++;
-}
-
-void editorRowInsertChar(erow *row, int at, int c) {
-  if (at < 0 || at > row->size) at = row->size;
-  row->chars = realloc(row->chars, row->size + 2);
-  memmove(&row->chars[at + 1], &row->chars[at], row->size - at + 1);
-  row->size++;
-  row->chars[at] = c;
-  editorUpdateRow(row);
-  E.dirty++;
-}
-
-void editorRowAppendString(erow *row, char *s, size_t len) {
-  row->chars = realloc(row->chars, row->size + len + 1);
-  memcpy(&row->chars[row->size], s, len);
-  row->size += len;
-  row->chars[row->size] = '\0';
-  editorUpdateRow(row);
-  E.dirty++;
-}
-
-void editorRowDelChar(erow *row, int at) {
-  if (at < 0 || at >= row->size) return;
-  memmove(&row->chars[at], &row->chars[at + 1], row->size - at);
-  row->size--;
-  editorUpdateRow(row);
-  E.dirty++;
-}
-
-/*** editor operations ***/
-
-void editorInsertChar(int c) {
-  if (E.cy == E.numrows) {  // On a tilde line; must append a row before inserting
-    editorInsertRow(E.numrows, "", 0);
-  }
-  editorRowInsertChar(&E.row[E.cy], E.cx, c);
-  E.cx++;
-}
-
-void editorInsertNewline(void) {
-  if (E.cx == 0) {
-    editorInsertRow(E.cy, "", 0);
-  } else {
-    erow *row = &E.row[E.cy];
-    editorInsertRow(E.cy + 1, &row->chars[E.cx], row->size - E.cx);
-    row = &E.row[E.cy];
-    row->size = E.cx;
-    row->chars[row->size] = '\0';
-    editorUpdateRow(row);
+    len += snprintf(&list[len], sizeof(list) - len, "%s%d:%.12s%s", j ? " " : "", j + 1, name,
+                    B->dirty ? "*" : "");
   }
 
-  E.cy++;
-  E.cx = 0;
-}
-
-void editorDelChar(void) {
-  if (E.cy == E.numrows) return;
-  if (E.cx == 0 && E.cy == 0) return;
+  char prompt[96];
+  snprintf(prompt, sizeof(prompt), "%s | buffer (c: close): %%s", list);
 
-  erow *row = &E.row[E.cy];
+  char *answer = editorPrompt(E, prompt, NULL);
+  if (answer == NULL) return;
 
-  if (E.cx > 0) {
-    editorRowDelChar(row, E.cx - 1);
-    E.cx--;
+  if (!strcmp(answer, "c")) {
+    if (E->buf->dirty) {
+      editorSetStatusMessage(E, "Buffer has unsaved changes; save it before closing");
+    } else {
+      editorBufferClose(E, E->current);
+    }
   } else {
-    E.cx = E.row[E.cy - 1].size;
-    editorRowAppendString(&E.row[E.cy - 1], row->chars, row->size);
-    editorDelRow(E.cy);
-    E.cy--;
-  }
-}
-
-/*** file i/o ***/
-
-char *editorRowsToString(int *buflen) {
-  int totlen = 0;
-  int j;
-  for (j = 0; j < E.numrows; j++) totlen += E.row[j].size + 1;
-  *buflen = totlen;
-
-  char *buf = malloc(totlen);
-  char *p = buf;
-  for (j = 0; j < E.numrows; j++) {
-    memcpy(p, E.row[j].chars, E.row[j].size);
-    p += E.row[j].size;
-    *p = '\n';
-    p++;
+    int idx = atoi(answer) - 1;
+    if (idx < 0 || idx >= E->numbuffers) {
+      editorSetStatusMessage(E, "No buffer %s", answer);
+    } else {
+      editorBufferSwitch(E, idx);
+    }
   }
-
-  return buf;
+  free(answer);
 }
 
-void editorOpen(char *filename) {
-  free(E.filename);  // Free memory pointed to before reassigning with pointer from `strdup()`
-  E.filename = strdup(filename);
-
-  editorSelectSyntaxHighlight();
-
-  FILE *fp = fopen(filename, "r");
-  if (!fp) die("fopen");
-
-  char *line = NULL;
-  size_t linecap = 0;
-  ssize_t linelen;
+/*** windows ***/
 
-  while ((linelen = getline(&line, &linecap, fp)) != -1) {  // Returns -1 at EOF
-    while (linelen > 0 && (line[linelen - 1] == '\n' || line[linelen - 1] == '\r'))
-      linelen--;
-
-    editorInsertRow(E.numrows, line, linelen);
-  }
-
-  free(line);
-  fclose(fp);
-  E.dirty = 0;
-}
+// Ctrl-W prefix: s/v split, w cycles focus, c closes, o keeps only the active window
+void editorWindowCommand(struct editorConfig *E) {
+  editorSetStatusMessage(E, "Window: s = split, v = vsplit, w = next, c = close, o = only");
+  editorRefreshScreen(E);
 
-void editorSave(void) {
-  if (E.filename == NULL) {
-    E.filename = editorPrompt("Save as: %s (ESC to cancel)", NULL);
+  int c = editorReadKey(E);
 
-    if (E.filename == NULL) {
-      editorSetStatusMessage("Save aborted");
+  switch (c) {
+      // clang-format off
+    case 's': case 'v':
+      if (editorWindowSplit(E, c == 's' ? 'h' : 'v') == -1)
+        editorSetStatusMessage(E, "Window too small to split");
+      else
+        editorSetStatusMessage(E, "");
       return;
-    }
-
-    editorSelectSyntaxHighlight();
-  }
-
-  int len;
-  char *buf = editorRowsToString(&len);
-
-  int fd = open(E.filename, O_RDWR | O_CREAT, 0644);
-  if (fd != -1) {
-    if (ftruncate(fd, len) != -1) {
-      if (write(fd, buf, len) == len) {
-        close(fd);
-        free(buf);
-        E.dirty = 0;
-        editorSetStatusMessage("%d bytes written to disk", len);
-        return;
+    case 'w': case CTRL_KEY('w'): editorWindowNext(E); break;
+    case 'c': editorWindowClose(E); break;
+    case 'o': {
+      struct editorWindow *keep = E->win;
+      while (E->layout->split) {
+        if (E->win == keep) editorWindowNext(E);
+        editorWindowClose(E);
       }
-    }
-    close(fd);
+      editorWindowFocus(E, keep);
+    } break;
+      // clang-format on
   }
-
-  free(buf);
-  editorSetStatusMessage("Can't save. I/O error: %s", strerror(errno));
+  editorSetStatusMessage(E, "");
 }
 
 /*** find ***/
 
-void editorFindCallback(char *query, int key) {
-  static int last_match = -1;
-  static int direction = 1;
-
-  static int saved_hl_line;
-  static char *saved_hl;
-
-  if (saved_hl) {
-    memcpy(E.row[saved_hl_line].hl, saved_hl, E.row[saved_hl_line].rsize);
-    free(saved_hl);
-    saved_hl = NULL;
-  }
-
-  // Return immediately if user pressed Esc or Enter to leave search mode
-  if (key == '\r' || key == '\x1b') {
-    last_match = -1;
-    direction = 1;
-    return;
-  } else if (key == ARROW_RIGHT || key == ARROW_DOWN) {
-    direction = 1;
-  } else if (key == ARROW_LEFT || key == ARROW_UP) {
-    direction = -1;
-  } else {
-    last_match = -1;
-    direction = 1;
-  }
-
-  if (last_match == -1) direction = 1;
-  int current = last_match;
-
-  for (int i = 0; i < E.numrows; i++) {
-    current += direction;
-
-    // Cycle from bottom of file to top, or vice versa
-    if (current == -1) {
-      current = E.numrows - 1;
-    } else if (current == E.numrows) {
-      current = 0;
-    }
-
-    erow *row = &E.row[current];
-    char *match = strstr(row->render, query);
-
-    if (match) {
-      last_match = current;
-      E.cy = current;
-      E.cx = editorRowRxToCx(row, match - row->render);
-      E.rowoff = E.numrows;
-
-      saved_hl_line = current;
-      saved_hl = malloc(row->rsize);
-      memcpy(saved_hl, row->hl, row->size);
-      memset(&row->hl[match - row->render], HL_MATCH, strlen(query));
-      break;
-    }
-  }
-}
-
-void editorFind(void) {
-  int saved_cx = E.cx;
-  int saved_cy = E.cy;
-  int saved_coloff = E.coloff;
-  int saved_rowoff = E.rowoff;
+void editorFind(struct editorConfig *E) {
+  struct editorBuffer *B = E->buf;
+  int saved_cx = B->cx;
+  int saved_cy = B->cy;
+  int saved_coloff = B->coloff;
+  int saved_rowoff = B->rowoff;
 
   char *query = editorPrompt(
-      "Search: %s (Use arrows to step, ESC/Enter to abort)", editorFindCallback);
+      E, "Search: %s (Use arrows to step, ESC/Enter to abort)", editorFindCallback);
 
   if (query) {
     free(query);
   } else {
-    E.cx = saved_cx;
-    E.cy = saved_cy;
-    E.coloff = saved_coloff;
-    E.rowoff = saved_rowoff;
+    B->cx = saved_cx;
+    B->cy = saved_cy;
+    B->coloff = saved_coloff;
+    B->rowoff = saved_rowoff;
   }
 }
 
-/*** append buffer ***/
-
-struct abuf {
-  char *b;
-  int len;
-};
-
-#define ABUF_INIT {.b = NULL, .len = 0}
-
-void abAppend(struct abuf *ab, const char *s, int len) {
-  char *new = realloc(ab->b, ab->len + len);
-
-  if (new == NULL) return;
-  memcpy(&new[ab->len], s, len);
-  ab->b = new;
-  ab->len += len;
-}
-
-void abFree(struct abuf *ab) {
-  free(ab->b);
-}
-
-/*** output ***/
-
-void editorScroll(void) {
-  E.rx = 0;
+// Jumps to a line, a percentage through the file or a byte offset
+void editorGotoLine(struct editorConfig *E) {
+  char *where = editorPrompt(E, "Go to: %s (line, N%% or @offset; ESC to cancel)", NULL);
+  if (where == NULL) return;
 
-  if (E.cy < E.numrows) {
-    E.rx = editorRowCxToRx(&E.row[E.cy], E.cx);
-  }
-
-  if (E.cy < E.rowoff)
-    E.rowoff = E.cy;                    // Scroll up to cursor, if above visible window
-  if (E.cy >= E.rowoff + E.screenrows)  // Cursor is below window
-    E.rowoff = E.cy - E.screenrows + 1;
-  if (E.rx < E.coloff)
-    E.coloff = E.rx;
-  if (E.rx >= E.coloff + E.screencols)
-    E.coloff = E.rx - E.screencols + 1;
+  if (editorGoto(E, where) == -1) editorSetStatusMessage(E, "Not a line, percentage or offset: %.40s", where);
+  free(where);
 }
 
-void editorDrawRows(struct abuf *ab) {
-  int y;
-  for (y = 0; y < E.screenrows; y++) {
-    int filerow = y + E.rowoff;
-    if (filerow >= E.numrows) {
-      if (E.numrows == 0 && y == E.screenrows / 3) {
-        char welcome[80];
-        int welcomelen = snprintf(welcome, sizeof(welcome), "Text editor -- version %s", EDITOR_VERSION);
-        if (welcomelen > E.screencols) welcomelen = E.screencols;
-        int padding = (E.screencols - welcomelen) / 2;
-        if (padding) {
-          abAppend(ab, "~", 1);
-          padding--;
-        }
-        while (padding--) abAppend(ab, " ", 1);
-        abAppend(ab, welcome, welcomelen);
-      } else {
-        abAppend(ab, "~", 1);
-      }
-    } else {
-      int len = E.row[filerow].rsize - E.coloff;
-      if (len < 0) len = 0;
-      if (len > E.screencols) len = E.screencols;
-
-      char *c = &E.row[filerow].render[E.coloff];
-
-      unsigned char *hl = &E.row[filerow].hl[E.coloff];
-      int current_color = -1;
-
-      for (int j = 0; j < len; j++) {
-        if (iscntrl(c[j])) {
-          char sym = (c[j] <= 26) ? '@' + c[j] : '?';
-          abAppend(ab, "\x1b[7m", 4);  // Inverted colors
-          abAppend(ab, &sym, 1);
-          abAppend(ab, "\x1b[m", 3);  // Turn off all text formatting, including colors
-
-          if (current_color != -1) {
-            char buf[16];
-            int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", current_color);
-            abAppend(ab, buf, clen);
-          }
-        } else if (hl[j] == HL_NORMAL) {
-          if (current_color != -1) {
-            abAppend(ab, "\x1b[39m", 5);  // Default text color
-            current_color = -1;
-          }
-
-          abAppend(ab, &c[j], 1);
-        } else {
-          int color = editorSyntaxToColor(hl[j]);
-          if (color != current_color) {
-            current_color = color;
-            char buf[16];
-            int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", color);
-            abAppend(ab, buf, clen);
-          }
-          abAppend(ab, &c[j], 1);
-        }
-      }
+// Replaces every match in the buffer, of text or of a regular expression written as `/.../`
+void editorReplace(struct editorConfig *E) {
+  if (editorReadOnly(E)) return;
 
-      abAppend(ab, "\x1b[39m", 5);
-    }
+  char *pattern = editorPrompt(E, "Replace: %s (text, or /regex/; ESC to cancel)", NULL);
+  if (pattern == NULL) return;
 
-    abAppend(ab, "\x1b[K", 3);  // Erase In Line (default 0: erase right of cursor)
-    abAppend(ab, "\r\n", 2);
+  size_t len = strlen(pattern);
+  int regex = (len > 2 && pattern[0] == '/' && pattern[len - 1] == '/');
+  if (regex) {
+    memmove(pattern, &pattern[1], len - 2);
+    pattern[len - 2] = '\0';
   }
-}
 
-void editorDrawStatusBar(struct abuf *ab) {
-  // Select Graphic Rendition (0: none [default], 1: bold, 4: underscore, 5: blink, 7: inverted colors)
-  abAppend(ab, "\x1b[7m", 4);
-
-  char status[80], rstatus[80];
-
-  int len = snprintf(
-      status,
-      sizeof(status),
-      "%.20s - %d lines%s",
-      E.filename ? E.filename : "[No Name]",
-      E.numrows,
-      E.dirty ? " (modified)" : "");
-
-  int rlen = snprintf(
-      rstatus,
-      sizeof(rstatus),
-      "%s | %d/%d",
-      E.syntax ? E.syntax->filetype : "no filetype",
-      E.cy + 1,
-      E.numrows);
-
-  if (len > E.screencols) len = E.screencols;
-  abAppend(ab, status, len);
-
-  while (len < E.screencols) {
-    if (E.screencols - len == rlen) {
-      abAppend(ab, rstatus, rlen);
-      break;
+  char *with = editorPromptText(
+      E, regex ? "Replace with: %s (\\1 to \\9 = groups; ESC to cancel)" : "Replace with: %s (ESC to cancel)", NULL,
+      1);
+  if (with) {
+    char err[80];
+    int n = editorReplaceAll(E->buf, pattern, with, regex, err, sizeof(err));
+    if (n == -1) {
+      editorSetStatusMessage(E, "Bad regex: %s", err);
     } else {
-      abAppend(ab, " ", 1);
-      len++;
+      editorSelectionClear(E);
+      editorSetStatusMessage(E, "Replaced %d occurrence%s", n, n == 1 ? "" : "s");
     }
+    free(with);
   }
-  abAppend(ab, "\x1b[m", 3);
-  abAppend(ab, "\r\n", 2);
-}
-
-void editorDrawMessageBar(struct abuf *ab) {
-  abAppend(ab, "\x1b[K", 3);  // Clear rest of line
-  int msglen = strlen(E.statusmsg);
-  if (msglen > E.screencols) msglen = E.screencols;
-  if (msglen && time(NULL) - E.statusmsg_time < 5) abAppend(ab, E.statusmsg, msglen);
+  free(pattern);
 }
 
-void editorRefreshScreen(void) {
-  editorScroll();
+/*** macro ***/
 
-  struct abuf ab = ABUF_INIT;
+// Replays the macro `times` times, or with `times` 0 until a search in it finds nothing. A failed
+// search ends any replay, as does a run that changes nothing when repeating until failure.
+void editorMacroRun(struct editorConfig *E, int times) {
+  struct editorMacro *M = &E->macro;
+  int runs = 0, failed = 0;
+  TRACE_BEGIN("editorMacroRun");
 
-  // Escape sequences always start with `\x1b` (27) followed by `[`
-  abAppend(&ab, "\x1b[?25l", 6);  // Reset Mode/turn off (25: cursor on/off, l: off)
-  abAppend(&ab, "\x1b[H", 3);     // Position cursor, default 1;1 (Cursor Position [H])
+  M->playing = 1;
+  while (runs < (times ? times : EDITOR_MACRO_MAX_RUNS)) {
+    struct editorBuffer *B = E->buf;
+    int cx = B->cx, cy = B->cy, dirty = B->dirty;
 
-  editorDrawRows(&ab);
-  editorDrawStatusBar(&ab);
-  editorDrawMessageBar(&ab);
+    M->pos = 0;
+    M->misses = E->find.misses;
+    while (M->pos < M->len && E->find.misses == M->misses) editorProcessKeypress(E);
+    if ((failed = E->find.misses != M->misses)) break;
+    if (times == 0 && E->buf == B && B->cx == cx && B->cy == cy && B->dirty == dirty) break;
+    runs++;
+  }
+  M->playing = 0;
 
-  char buf[32];
-  snprintf(
-      buf,
-      sizeof(buf),
-      "\x1b[%d;%dH",        // Move cursor back to top-left
-      E.cy - E.rowoff + 1,  // Account for scrolling
-      E.rx - E.coloff + 1);
-  abAppend(&ab, buf, strlen(buf));
+  editorSetStatusMessage(E, "Macro ran %d time%s%s", runs, runs == 1 ? "" : "s",
+                         failed ? "; stopped where a search failed" : "");
+  TRACE_END("editorMacroRun");
+}
 
-  abAppend(&ab, "\x1b[?25h", 6);  // Set Mode/turn on (25: cursor on/off, h: on)
+// Asks how many times to replay the macro
+void editorMacroPrompt(struct editorConfig *E) {
+  if (E->macro.len == 0) {
+    editorSetStatusMessage(E, "No macro recorded (Ctrl-K starts recording)");
+    return;
+  }
 
-  write(STDOUT_FILENO, ab.b, ab.len);
-  abFree(&ab);
-}
+  char *answer = editorPromptText(E, "Run macro: %s times (Enter = until a search fails; ESC to cancel)", NULL, 1);
+  if (answer == NULL) return;
 
-void editorSetStatusMessage(const char *fmt, ...) {
-  va_list ap;
-  va_start(ap, fmt);
-  vsnprintf(E.statusmsg, sizeof(E.statusmsg), fmt, ap);
-  va_end(ap);
-  E.statusmsg_time = time(NULL);  // Current time (seconds since 1970-01-01)
+  char *end;
+  long times = strtol(answer, &end, 10);
+  if (*end != '\0' || times < 0 || times > INT_MAX) {
+    editorSetStatusMessage(E, "Not a number of times: %.40s", answer);
+  } else {
+    editorMacroRun(E, times);
+  }
+  free(answer);
 }
 
 /*** input ***/
 
 // `prompt` is expected to be a format string with a `%s`
-char *editorPrompt(char *prompt, void (*callback)(char *, int)) {
+char *editorPrompt(struct editorConfig *E, char *prompt, void (*callback)(struct editorConfig *, char *, int)) {
+  return editorPromptText(E, prompt, callback, 0);
+}
+
+// As `editorPrompt()`, but Enter on an empty answer returns it if `allow_empty` is set
+char *editorPromptText(struct editorConfig *E, char *prompt, void (*callback)(struct editorConfig *, char *, int),
+                       int allow_empty) {
   size_t bufsize = 128;
   char *buf = malloc(bufsize);
   size_t buflen = 0;
   buf[0] = '\0';
 
   while (1) {
-    editorSetStatusMessage(prompt, buf);
-    editorRefreshScreen();
+    editorSetStatusMessage(E, prompt, buf);
+    editorRefreshScreen(E);
 
-    int c = editorReadKey();
+    int c = editorReadKey(E);
 
     if (c == DEL_KEY || c == CTRL_KEY('h') || c == BACKSPACE) {
       if (buflen != 0) buf[--buflen] = '\0';
     } else if (c == '\x1b') {
-      editorSetStatusMessage("");
-      if (callback) callback(buf, c);
+      editorSetStatusMessage(E, "");
+      if (callback) callback(E, buf, c);
       free(buf);
       return NULL;
     } else if (c == '\r') {
-      if (buflen != 0) {
-        editorSetStatusMessage("");
-        if (callback) callback(buf, c);
+      if (buflen != 0 || allow_empty) {
+        editorSetStatusMessage(E, "");
+        if (callback) callback(E, buf, c);
         return buf;
       }
     } else if (!iscntrl(c) && c < 128) {
@@ -960,129 +477,445 @@ char *editorPrompt(char *prompt, void (*callback)(char *, int)) {
       buf[buflen] = '\0';
     }
 
-    if (callback) callback(buf, c);
+    if (callback) callback(E, buf, c);
   }
 }
 
-void editorMoveCursor(int key) {
-  erow *row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
+void editorMoveCursor(struct editorBuffer *B, int key) {
+  erow *row = (B->cy >= B->numrows) ? NULL : editorRow(B, B->cy);
 
   switch (key) {
       // clang-format off
     case ARROW_LEFT:
-      if (E.cx != 0) E.cx--;
-      else if (E.cy > 0) {
-        E.cy--;
-        E.cx = E.row[E.cy].size;
+      if (B->cx != 0) B->cx--;
+      else if (B->cy > 0) {
+        B->cy--;
+        B->cx = editorRow(B, B->cy)->size;
       }
       break;
     case ARROW_RIGHT:
-      if (row && E.cx < row->size) E.cx++;
-      else if (row && E.cx == row->size) {
-        E.cy++;
-        E.cx = 0;
+      if (row && B->cx < row->size) B->cx++;
+      else if (row && B->cx == row->size) {
+        B->cy++;
+        B->cx = 0;
       }
       break;
-    case ARROW_UP:    if (E.cy != 0)               E.cy--; break;
-    case ARROW_DOWN:  if (E.cy < E.numrows)        E.cy++; break;
+    case ARROW_UP:    if (B->cy != 0)               B->cy--; break;
+    case ARROW_DOWN:  if (B->cy < B->numrows)        B->cy++; break;
       // clang-format on
   }
 
-  row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
+  row = (B->cy >= B->numrows) ? NULL : editorRow(B, B->cy);
   int rowlen = row ? row->size : 0;
-  if (E.cx > rowlen) E.cx = rowlen;
+  if (B->cx > rowlen) B->cx = rowlen;
+}
+
+// Edits are refused while the file is still loading in the background or being followed, and in
+// files opened with `-R`
+int editorReadOnly(struct editorConfig *E) {
+  if (E->buf->pager) {
+    editorSetStatusMessage(E, "Read-only: opened with -R");
+  } else if (E->buf->loader) {
+    editorSetStatusMessage(E, "Read-only until the file has finished loading");
+  } else if (E->buf->pipe) {
+    editorSetStatusMessage(E, "Read-only until the input has all been read");
+  } else if (E->buf->saver) {
+    editorSetStatusMessage(E, "Read-only until the compressed file has been written");
+  } else if (E->buf->follow) {
+    editorSetStatusMessage(E, "Read-only while following the file (Ctrl-T to stop)");
+  } else {
+    return 0;
+  }
+  return 1;
 }
 
-void editorProcessKeypress(void) {
+void editorProcessKeypress(struct editorConfig *E) {
   static int quit_times = EDITOR_QUIT_TIMES;
 
-  int c = editorReadKey();
+  struct editorBuffer *B = E->buf;
+  int c = editorReadKey(E);
 
   switch (c) {
       // clang-format off
     case '\r':
-      editorInsertNewline();
+      editorSelectionClear(E);
+      if (!editorReadOnly(E)) editorInsertNewline(B);
       break;
 
+    // Quitting, opening files, and switching buffers or windows only make sense at a terminal,
+    // so a batch macro that replays these keys leaves them out
     case CTRL_KEY('q'):
-      if (E.dirty && quit_times > 0) {
-        editorSetStatusMessage("WARNING!!! File has unsaved changes. "
+      if (E->macro.playing) break;
+      if (editorAnyDirty(E) && quit_times > 0) {
+        editorSetStatusMessage(E, "WARNING!!! Buffers have unsaved changes. "
           "Press Ctrl-Q %d more times to quit.", quit_times);
         quit_times--;
         return;
       }
 
+      editorFree(E);  // Unsaved changes are being discarded, so their journals go too
       write(STDOUT_FILENO, "\x1b[2J", 4);
       write(STDOUT_FILENO, "\x1b[H", 3);
       exit(0);
 
     case CTRL_KEY('s'):
-      editorSave();
+      editorSaveFile(E);
       break;
 
-    case HOME_KEY: E.cx = 0; break;
+    case HOME_KEY: B->cx = 0; break;
     case END_KEY:
-      if (E.cy < E.numrows) E.cx = E.row[E.cy].size;
+      if (B->cy < B->numrows) B->cx = editorRow(B, B->cy)->size;
       break;
   
     case CTRL_KEY('f'):
-      editorFind();
+      editorFind(E);
+      break;
+
+    case CTRL_KEY('o'):
+      if (E->macro.playing) break;
+      editorOpenFile(E);
+      break;
+
+    case CTRL_KEY('g'):
+      editorGotoLine(E);
+      break;
+
+    case CTRL_KEY('r'):
+      editorReplace(E);
+      break;
+
+    // Ctrl-K starts and stops recording keys; Ctrl-E replays them, ending a recording first
+    case CTRL_KEY('k'):
+      if (E->macro.playing) break;  // Only batch mode can replay these keys
+      if (E->macro.recording) {
+        int n = editorMacroStop(E);
+        editorSetStatusMessage(E, "Recorded %d key%s; Ctrl-E = replay", n, n == 1 ? "" : "s");
+      } else {
+        editorMacroStart(E);
+        editorSetStatusMessage(E, "Recording keys; Ctrl-K = stop");
+      }
+      break;
+
+    case CTRL_KEY('e'):
+      if (E->macro.playing) break;
+      if (E->macro.recording) editorMacroStop(E);
+      editorMacroPrompt(E);
+      break;
+
+    case CTRL_KEY('b'):
+      if (E->macro.playing) break;
+      editorSwitchBuffer(E);
+      break;
+
+    case CTRL_KEY('w'):
+      if (E->macro.playing) break;
+      editorWindowCommand(E);
+      break;
+
+    case CTRL_KEY('t'):
+      editorFollow(E, !B->follow);
+      break;
+
+    // Ctrl-Space sets the mark; the region up to the cursor is then selected
+    case CTRL_KEY('@'):
+      if (E->selection.buf == B) {
+        editorSelectionClear(E);
+        editorSetStatusMessage(E, "Mark cleared");
+      } else {
+        editorSelectionStart(E);
+        editorSetStatusMessage(E, "Mark set; Ctrl-X/C = cut/copy, Tab/Shift-Tab = indent/unindent");
+      }
+      break;
+
+    case CTRL_KEY('x'): case CTRL_KEY('c'):
+      if (c == CTRL_KEY('x') && editorReadOnly(E)) break;
+      if ((c == CTRL_KEY('x') ? editorSelectionCut(E) : editorSelectionCopy(E)) == -1)
+        editorSetStatusMessage(E, "Nothing selected (Ctrl-Space sets the mark)");
+      break;
+
+    case CTRL_KEY('v'):
+      if (editorReadOnly(E)) break;
+      if (editorClipboardPaste(E) == -1) editorSetStatusMessage(E, "Clipboard is empty");
       break;
 
+    case '\t': case SHIFT_TAB: {
+      int y0, x0, y1, x1;
+      if (editorReadOnly(E)) break;
+      if (c == SHIFT_TAB || editorSelectionBounds(E, &y0, &x0, &y1, &x1))
+        editorSelectionIndent(E, c == SHIFT_TAB ? -1 : 1);
+      else
+        editorInsertChar(B, c);
+    } break;
+
     case BACKSPACE: case DEL_KEY: case CTRL_KEY('h'):
-      if (c == DEL_KEY) editorMoveCursor(ARROW_RIGHT);
-      editorDelChar();
+      editorSelectionClear(E);
+      if (editorReadOnly(E)) break;
+      if (c == DEL_KEY) editorMoveCursor(B, ARROW_RIGHT);
+      editorDelChar(B);
       break;
 
+    // A screen above the top row or below the bottom one, as `rows` presses of the arrow would
     case PAGE_UP: case PAGE_DOWN: {
       if (c == PAGE_UP) {
-        E.cy = E.rowoff;
+        B->cy = B->rowoff - E->win->rows;
+        if (B->cy < 0) B->cy = 0;
       } else if (c == PAGE_DOWN) {
-        E.cy = E.rowoff + E.screenrows - 1;
-        if (E.cy > E.numrows) E.cy = E.numrows;
+        B->cy = B->rowoff + 2 * E->win->rows - 1;
+        if (B->cy > B->numrows) B->cy = B->numrows;
       }
 
-      int times = E.screenrows;  // Block allows declaration of `times` local variable
-      while (times--) editorMoveCursor(c == PAGE_UP ? ARROW_UP : ARROW_DOWN);
+      int rowlen = B->cy < B->numrows ? editorRow(B, B->cy)->size : 0;
+      if (B->cx > rowlen) B->cx = rowlen;
     } break;
 
     case ARROW_UP: case ARROW_DOWN: case ARROW_LEFT: case ARROW_RIGHT:
-      editorMoveCursor(c);
+      editorMoveCursor(B, c);
+      break;
+
+    // Ctrl-L repaints every window, over anything else that was written to the terminal
+    case CTRL_KEY('l'):
+      E->relayout = 1;
       break;
 
-    case CTRL_KEY('l'): case '\x1b': break;
+    case '\x1b': editorSelectionClear(E); break;
 
-    default: editorInsertChar(c); break;
+    default:
+      editorSelectionClear(E);
+      if (!editorReadOnly(E)) editorInsertChar(B, c);
+      break;
       // clang-format on
   }
 
   quit_times = EDITOR_QUIT_TIMES;
 }
 
-/*** init ***/
+/*** batch ***/
+
+// Batch mode (`-c`): commands edit a file with no terminal at all. Each command is a name and its
+// argument, from a `-c` option or, with `-c -`, a line of standard input. The first command
+// that fails stops the script.
+
+static int batchError(const char *cmd, const char *msg) {
+  fprintf(stderr, "editor: %s: %s\n", cmd, msg);
+  return -1;
+}
+
+// Loads `keys` into the macro. Escapes stand for keys that can't be typed in a script: `\n`
+// Enter, `\t` Tab, `\e` Esc, `\b` Backspace, `\U` `\D` `\L` `\R` arrows, `\H` `\E` Home and
+// End, `\X` Delete, `\xNN` any byte (`\x06` is Ctrl-F) and `\\` a backslash.
+static int batchKeys(struct editorConfig *E, const char *keys) {
+  editorMacroStart(E);
+  for (const char *s = keys; *s; s++) {
+    int key = *s;
+    if (key == '\\') {
+      switch (*++s) {
+          // clang-format off
+        case 'n':  key = '\r'; break;
+        case 't':  key = '\t'; break;
+        case 'e':  key = '\x1b'; break;
+        case 'b':  key = BACKSPACE; break;
+        case 'U':  key = ARROW_UP; break;
+        case 'D':  key = ARROW_DOWN; break;
+        case 'L':  key = ARROW_LEFT; break;
+        case 'R':  key = ARROW_RIGHT; break;
+        case 'H':  key = HOME_KEY; break;
+        case 'E':  key = END_KEY; break;
+        case 'X':  key = DEL_KEY; break;
+        case '\\': key = '\\'; break;
+        case 'x': {
+          char hex[3] = {s[1], s[1] ? s[2] : '\0', '\0'}, *end;
+          key = strtol(hex, &end, 16);
+          if (end != &hex[2]) return -1;
+          s += 2;
+        } break;
+        default: return -1;
+          // clang-format on
+      }
+    }
+    editorMacroRecord(E, key);
+  }
+  E->macro.recording = 0;
+  return 0;
+}
+
+// Splits `/text/with/` at its delimiter, the first character, into `*pattern` and `*with`
+static int batchSplit(char *arg, char **pattern, char **with) {
+  char sep = arg[0];
+  if (sep == '\0') return -1;
+  char *mid = strchr(&arg[1], sep);
+  if (mid == NULL) return -1;
+
+  *mid = '\0';
+  char *end = strchr(&mid[1], sep);
+  if (end) *end = '\0';
+  *pattern = &arg[1];
+  *with = &mid[1];
+  return 0;
+}
+
+static int batchCommand(struct editorConfig *E, char *line) {
+  struct editorBuffer *B = E->buf;
+  char *cmd = line + strspn(line, " \t");
+  char *arg = cmd + strcspn(cmd, " \t");
+  if (*arg) *arg++ = '\0';
+  arg += strspn(arg, " \t");
+  if (*cmd == '\0' || *cmd == '#') return 0;
+
+  if (!strcmp(cmd, "goto")) {
+    if (editorGoto(E, arg) == -1) return batchError(cmd, "not a line, percentage or offset");
+  } else if (!strcmp(cmd, "find")) {
+    int misses = E->find.misses;
+    editorFindCallback(E, arg, 'n');
+    editorFindCallback(E, arg, '\r');
+    if (E->find.misses != misses) return batchError(cmd, "no match");
+  } else if (!strcmp(cmd, "replace") || !strcmp(cmd, "replace-regex")) {
+    char *pattern, *with, err[80];
+    if (batchSplit(arg, &pattern, &with) == -1) return batchError(cmd, "expected /text/replacement/");
+    int regex = !strcmp(cmd, "replace-regex");
+    if (editorReplaceAll(B, pattern, with, regex, err, sizeof(err)) == -1) return batchError(cmd, err);
+  } else if (!strcmp(cmd, "macro")) {
+    char *keys;
+    long times = strtol(arg, &keys, 10);
+    if (keys == arg || times < 0 || times > INT_MAX || batchKeys(E, keys + strspn(keys, " \t")) == -1) {
+      return batchError(cmd, "expected a number of times (0 = until a search fails) and keys");
+    }
+    editorMacroRun(E, times);
+  } else if (!strcmp(cmd, "save")) {
+    if (*arg) {
+      editorWatchRemove(E, B);
+      editorSetFilename(B, arg);
+    }
+    if (B->filename == NULL) return batchError(cmd, "no file name");
+    if (editorSave(E) == -1 || editorSaverFinish(E, B) == -1) return batchError(cmd, E->statusmsg);
+  } else if (!strcmp(cmd, "print")) {
+    if (editorWriteRows(B, STDOUT_FILENO) == -1) return batchError(cmd, strerror(errno));
+  } else {
+    return batchError(cmd, "unknown command");
+  }
+  return 0;
+}
+
+// Runs the `-c` commands in `argv` against `filename` (or an empty buffer). Returns the exit status.
+int editorBatch(int argc, char *argv[], char *filename) {
+  struct editorConfig E;
+  editorInit(&E, 0, 0);
+  E.buf->journal.suspended++;  // Scripts leave no journal, and replay none onto their input
+  E.buf->plain = 1;             // Nor are their rows highlighted
+
+  // Standard input can be the file or the script, but not both
+  int stdin_script = 0;
+  for (int j = 1; j + 1 < argc; j++) {
+    if (!strcmp(argv[j], "-c") && !strcmp(argv[++j], "-")) stdin_script = 1;
+  }
+  if (stdin_script && filename && !strcmp(filename, "-")) {
+    fprintf(stderr, "editor: -c -: standard input is already the file being edited\n");
+    editorFree(&E);
+    return 1;
+  }
+
+  int status = 0;
+  if (filename && !strcmp(filename, "-")) {
+    editorPipeOpen(E.buf, dup(STDIN_FILENO));
+    editorPipeFinish(E.buf);
+  } else if (filename && editorOpen(E.buf, filename) == -1 && errno != ENOENT) {
+    fprintf(stderr, "editor: %s: %s\n", filename, strerror(errno));
+    status = 1;
+  }
+
+  for (int j = 1; j < argc && status == 0; j++) {
+    if (strcmp(argv[j], "-c") || j + 1 == argc) continue;
+    char *script = argv[++j];
 
-void initEditor(void) {
-  E.cx = E.cy = E.rx = E.rowoff = E.coloff = E.numrows = E.dirty = 0;
-  E.row = NULL;  // Should already be NULL, as `E` is a global struct...
-  E.filename = NULL;
-  E.statusmsg[0] = '\0';
-  E.statusmsg_time = 0;
-  E.syntax = NULL;
+    if (strcmp(script, "-")) {
+      if (batchCommand(&E, script) == -1) status = 1;
+      continue;
+    }
+
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t len;
+    while (status == 0 && (len = getline(&line, &cap, stdin)) != -1) {
+      if (len > 0 && line[len - 1] == '\n') line[len - 1] = '\0';
+      if (batchCommand(&E, line) == -1) status = 1;
+    }
+    free(line);
+  }
 
-  if (getWindowSize(&E.screenrows, &E.screencols) == -1) die("getWindowSize");
-  E.screenrows -= 2;
+  editorFree(&E);
+  return status;
 }
 
+/*** init ***/
+
 int main(int argc, char *argv[]) {
+  struct editorConfig E;
+  int screenrows, screencols;
+
+  traceInit();
+
+  // With `-c`, the commands run against the one file named, and no terminal is needed
+  int batch = 0;
+  char *batch_file = NULL;
+  for (int j = 1; j < argc; j++) {
+    if (!strcmp(argv[j], "-c") && j + 1 < argc) {
+      batch = 1;
+      j++;
+    } else if (batch_file == NULL) {
+      batch_file = argv[j];
+    }
+  }
+  if (batch) return editorBatch(argc, argv, batch_file);
+
+  // `-` reads standard input into a buffer, so keys come from the terminal itself instead
+  int input = -1;
+  for (int j = 1; j < argc && input == -1; j++) {
+    if (strcmp(argv[j], "-")) continue;
+    input = dup(STDIN_FILENO);
+    int tty = open("/dev/tty", O_RDWR);
+    if (input == -1 || tty == -1 || dup2(tty, STDIN_FILENO) == -1) die("/dev/tty");
+    close(tty);
+  }
+
   enableRawMode();
-  initEditor();
-  if (argc >= 2) editorOpen(argv[1]);
+  if (getWindowSize(&screenrows, &screencols) == -1) die("getWindowSize");
+  editorInit(&E, screenrows - 2, screencols);  // Leave room for the status and message bars
+
+  // Filetypes beyond the built-in ones, before any file is opened
+  char *syntax_dir = getenv("EDITOR_SYNTAX");
+  char syntax_err[80];
+  int syntax_ok = editorSyntaxLoad(syntax_dir ? syntax_dir : EDITOR_SYNTAX_DIR, syntax_err, sizeof(syntax_err)) == 0;
+
+  char *theme = getenv("EDITOR_THEME");
+  int theme_ok = theme == NULL || editorThemeSet(&E, theme) == 0;
+
+  int pager = 0;
+  int files = 0;
+  for (int j = 1; j < argc; j++) {
+    // `-R` opens the files after it as read-only pagers, which hold no rows in memory
+    if (!strcmp(argv[j], "-R")) {
+      pager = 1;
+      continue;
+    }
+
+    if (files++ > 0) editorBufferNew(&E);  // One buffer per file; the first one stays current
+    struct editorBuffer *B = E.buffers[E.numbuffers - 1];
+    if (!strcmp(argv[j], "-")) {
+      if (input != -1) editorPipeOpen(B, input);
+      input = -1;  // Standard input can only be read once; another `-` is an empty buffer
+      continue;
+    }
+    if (pager && editorPagerOpen(B, argv[j]) == 0) continue;
+    if (editorOpenAsync(B, argv[j]) == -1) die("fopen");
+  }
 
-  editorSetStatusMessage("HELP: Ctrl-S = save | Ctrl-Q = quit | Ctrl-F = find");
+  editorSetStatusMessage(&E, "HELP: Ctrl-S = save | Ctrl-Q = quit | Ctrl-F = find | Ctrl-O/B = open/switch");
+  if (!syntax_ok) editorSetStatusMessage(&E, "Syntax file skipped: %s", syntax_err);
+  if (!theme_ok) editorSetStatusMessage(&E, "Unknown theme %.20s; try basic, 256 or truecolor", theme);
 
   while (1) {
-    editorRefreshScreen();
-    editorProcessKeypress();
+    editorPoll(&E);
+    editorRefreshScreen(&E);
+    editorProcessKeypress(&E);
   }
 
   return 0;
@@ -0,0 +1,22 @@
+/*** includes ***/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "editor.h"
+
+/*** append buffer ***/
+
+void abAppend(struct abuf *ab, const char *s, int len) {
+  if (len <= 0) return;  // `realloc()` to 0 bytes may free the buffer
+  char *new = realloc(ab->b, ab->len + len);
+
+  if (new == NULL) return;
+  memcpy(&new[ab->len], s, len);
+  ab->b = new;
+  ab->len += len;
+}
+
+void abFree(struct abuf *ab) {
+  free(ab->b);
+}
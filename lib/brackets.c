@@ -0,0 +1,196 @@
+/*** includes ***/
+
+#include <stdlib.h>
+
+#include "editor.h"
+
+/*** brackets ***/
+
+// Bracket matching without scanning the text in between. Highlighting a row also sums up its
+// code brackets (`erow.brackets`); a segment tree over those sums finds the first row, after or
+// before the cursor's, where the depth returns to the cursor's bracket, and only that row is
+// scanned for the partner. All three kinds of bracket nest together; a partner of another kind
+// is a mismatch and is not shown. Editing a row updates its leaf; inserting or deleting rows
+// marks the tree for a rebuild from the sums the rows already hold.
+
+static int bracketDelta(char c) {
+  switch (c) {
+      // clang-format off
+    case '(': case '[': case '{': return 1;
+    case ')': case ']': case '}': return -1;
+    default:                      return 0;
+      // clang-format on
+  }
+}
+
+static int bracketPair(char open, char close) {
+  return (open == '(' && close == ')') || (open == '[' && close == ']') || (open == '{' && close == '}');
+}
+
+// Whether rendered column `rx` is code, given `*s`, the first span that may still reach it.
+// Columns must be asked about in order, forwards or backwards.
+static int bracketIsCode(erow *row, int rx, int *s, int dir) {
+  if (dir > 0) {
+    while (*s < row->nhl && row->hl[*s].start + row->hl[*s].len <= rx) (*s)++;
+  } else {
+    while (*s >= 0 && row->hl[*s].start > rx) (*s)--;
+  }
+  if (*s < 0 || *s >= row->nhl || row->hl[*s].start > rx || row->hl[*s].start + row->hl[*s].len <= rx) {
+    return 1;
+  }
+  int hl = row->hl[*s].hl;
+  return hl != HL_COMMENT && hl != HL_MLCOMMENT && hl != HL_STRING;
+}
+
+// Sums up the brackets of a freshly highlighted row. A row of an evicted buffer has no spans
+// either, so its text is used as is.
+void editorBracketsCount(erow *row) {
+  const char *text = row->render ? row->render : row->chars;
+  int len = row->render ? row->rsize : row->size;
+  int depth = 0, low = 0, s = 0;
+
+  for (int rx = 0; rx < len; rx++) {
+    int d = bracketDelta(text[rx]);
+    if (d == 0 || !bracketIsCode(row, rx, &s, 1)) continue;
+    depth += d;
+    if (depth < low) low = depth;
+  }
+  row->brackets.net = depth;
+  row->brackets.low = low;
+}
+
+static struct editorBracketSum bracketCombine(struct editorBracketSum a, struct editorBracketSum b) {
+  struct editorBracketSum c = {a.net + b.net, a.low < a.net + b.low ? a.low : a.net + b.low};
+  return c;
+}
+
+// Leaves of the tree: a power of two at least the row count
+static int bracketLeaves(struct editorBuffer *B) {
+  int n = 1;
+  while (n < B->numrows) n *= 2;
+  return n;
+}
+
+static void bracketBuild(struct editorBuffer *B) {
+  int n = bracketLeaves(B);
+  struct editorBracketSum *T = realloc(B->bracket_tree, sizeof(struct editorBracketSum) * 2 * n);
+  B->bracket_tree = T;
+
+  for (int j = 0; j < n; j++) {
+    T[n + j] = j < B->numrows ? B->row[j].brackets : (struct editorBracketSum){0, 0};
+  }
+  for (int j = n - 1; j > 0; j--) T[j] = bracketCombine(T[2 * j], T[2 * j + 1]);
+  B->bracket_rows = B->numrows;
+}
+
+void editorBracketsInvalidate(struct editorBuffer *B) {
+  B->bracket_rows = -1;
+}
+
+// Row `at` was highlighted again
+void editorBracketsChanged(struct editorBuffer *B, int at) {
+  if (B->bracket_rows != B->numrows || at >= B->numrows) return;
+
+  struct editorBracketSum *T = B->bracket_tree;
+  int j = bracketLeaves(B) + at;
+  T[j] = B->row[at].brackets;
+  for (j /= 2; j > 0; j /= 2) T[j] = bracketCombine(T[2 * j], T[2 * j + 1]);
+}
+
+// First row of node `j` (covering rows `lo` to `hi`, exclusive) at or after `from` where the depth
+// `*depth` drops to 0, or -1 having added the rows' net change to `*depth`
+static int bracketFindAfter(struct editorBracketSum *T, int j, int lo, int hi, int from, int *depth) {
+  if (hi <= from) return -1;
+  if (lo >= from && *depth + T[j].low > 0) {
+    *depth += T[j].net;
+    return -1;
+  }
+  if (hi - lo == 1) return lo;
+
+  int mid = (lo + hi) / 2;
+  int y = bracketFindAfter(T, 2 * j, lo, mid, from, depth);
+  return y != -1 ? y : bracketFindAfter(T, 2 * j + 1, mid, hi, from, depth);
+}
+
+// Last row of node `j` before `to` where `*depth` unmatched closing brackets are all closed,
+// walking upwards
+static int bracketFindBefore(struct editorBracketSum *T, int j, int lo, int hi, int to, int *depth) {
+  if (lo >= to) return -1;
+  if (hi <= to && *depth + T[j].low - T[j].net > 0) {
+    *depth -= T[j].net;
+    return -1;
+  }
+  if (hi - lo == 1) return lo;
+
+  int mid = (lo + hi) / 2;
+  int y = bracketFindBefore(T, 2 * j + 1, mid, hi, to, depth);
+  return y != -1 ? y : bracketFindBefore(T, 2 * j, lo, mid, to, depth);
+}
+
+// Scans `row` from column `rx` in direction `dir` for the bracket that brings `*depth` to 0
+static int bracketScan(erow *row, int rx, int dir, int *depth) {
+  int s = dir > 0 ? 0 : row->nhl - 1;
+  for (; rx >= 0 && rx < row->rsize; rx += dir) {
+    int d = bracketDelta(row->render[rx]);
+    if (d == 0 || !bracketIsCode(row, rx, &s, dir)) continue;
+    *depth += d * dir;
+    if (*depth == 0) return rx;
+  }
+  return -1;
+}
+
+// Finds the partner of the bracket at rendered column `rx` of row `y`. Returns 0 if there is no
+// code bracket there or it has no partner of its own kind.
+int editorBracketsFind(struct editorBuffer *B, int y, int rx, int *match_y, int *match_rx) {
+  erow *row = &B->row[y];
+  editorRowRestore(B, row);
+  if (rx >= row->rsize) return 0;
+
+  int dir = bracketDelta(row->render[rx]);
+  int s = dir > 0 ? 0 : row->nhl - 1;
+  if (dir == 0 || !bracketIsCode(row, rx, &s, dir)) return 0;
+
+  if (B->bracket_rows != B->numrows) bracketBuild(B);
+  int n = bracketLeaves(B);
+
+  int depth = 1;  // Brackets still to close, counted in the direction of travel
+  int my = y;
+  int mrx = bracketScan(row, rx + dir, dir, &depth);
+  if (mrx == -1) {
+    my = dir > 0 ? bracketFindAfter(B->bracket_tree, 1, 0, n, y + 1, &depth)
+                 : bracketFindBefore(B->bracket_tree, 1, 0, n, y, &depth);
+    if (my == -1 || my >= B->numrows) return 0;
+
+    erow *match = &B->row[my];
+    editorRowRestore(B, match);
+    mrx = bracketScan(match, dir > 0 ? 0 : match->rsize - 1, dir, &depth);
+    if (mrx == -1) return 0;
+  }
+
+  char c = B->row[my].render[mrx];
+  if (!(dir > 0 ? bracketPair(row->render[rx], c) : bracketPair(c, row->render[rx]))) return 0;
+  *match_y = my;
+  *match_rx = mrx;
+  return 1;
+}
+
+// Finds the bracket pair at the cursor of the active window, and has the buffer repainted if it
+// differs from the one on screen
+void editorBracketsUpdate(struct editorConfig *E) {
+  struct editorBuffer *B = E->buf;
+  struct editorBracketMatch m = {0};
+
+  if (!B->pager && B->cy < B->numrows) {
+    m.line = B->cy;
+    m.rx = B->rx;
+    m.shown = editorBracketsFind(B, m.line, m.rx, &m.match_line, &m.match_rx);
+  }
+
+  struct editorBracketMatch *old = &E->brackets;
+  if (m.shown != old->shown ||
+      (m.shown && (m.line != old->line || m.rx != old->rx || m.match_line != old->match_line ||
+                   m.match_rx != old->match_rx))) {
+    if (m.shown || old->shown) B->version++;
+    *old = m;
+  }
+}
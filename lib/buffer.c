@@ -0,0 +1,465 @@
+/*** includes ***/
+
+// Feature test macros (portability): https://www.gnu.org/software/libc/manual/html_node/Feature-Test-Macros.html
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "editor.h"
+
+#define WRITE_BLOCK (1 << 20)  // Bytes of rows gathered per `write()` when saving
+
+/*** buffer ***/
+
+void editorInit(struct editorConfig *E, int screenrows, int screencols) {
+  E->statusmsg[0] = '\0';
+  E->statusmsg_time = 0;
+
+  E->find.last_match = -1;
+  E->find.direction = 1;
+  E->find.match_line = 0;
+  E->find.match_rx = 0;
+  E->find.match_len = 0;
+  E->find.misses = 0;
+  E->find.typing = 0;
+
+  memset(&E->brackets, 0, sizeof(E->brackets));
+  memset(&E->selection, 0, sizeof(E->selection));
+  memset(&E->clipboard, 0, sizeof(E->clipboard));
+  memset(&E->macro, 0, sizeof(E->macro));
+
+  E->screenrows = screenrows;
+  E->screencols = screencols;
+  E->theme = editorThemeDefault();
+
+  poolInit(&E->pool, EDITOR_POOL_LIMIT);
+  E->buffers = NULL;
+  E->numbuffers = 0;
+  E->switches = 0;
+  E->buf = editorBufferNew(E);  // An editor always has at least one (possibly empty) buffer
+  E->current = 0;
+
+  editorWindowsInit(E);
+  editorWatchInit(E);
+}
+
+static void editorBufferFree(struct editorBuffer *B) {
+  editorLoaderCancel(B);
+  editorPipeCancel(B);
+  editorSaverWait(B);
+  editorHighlighterCancel(B);
+  editorClipboardTouch(B, 0);  // What was copied from it outlives it
+  editorJournalFree(&B->journal);
+  if (B->pager) {
+    editorPagerFree(B);
+  } else {
+    for (int j = 0; j < B->numrows; j++) editorFreeRow(B, &B->row[j]);
+  }
+  free(B->row);
+  free(B->line_offsets);
+  free(B->bracket_tree);
+  free(B->filename);
+  free(B);
+}
+
+void editorFree(struct editorConfig *E) {
+  E->find.match_len = 0;
+  E->selection.buf = NULL;
+  editorClipboardClear(E);
+  editorMacroFree(E);
+
+  editorWindowsFree(E);
+  for (int j = 0; j < E->numbuffers; j++) editorBufferFree(E->buffers[j]);
+  free(E->buffers);
+  E->buffers = NULL;
+  E->numbuffers = 0;
+  E->buf = NULL;
+
+  editorWatchFree(E);
+  poolTrim(&E->pool);
+}
+
+// Appends an empty buffer to the buffer list; the current buffer is unchanged
+struct editorBuffer *editorBufferNew(struct editorConfig *E) {
+  struct editorBuffer *B = calloc(1, sizeof(struct editorBuffer));
+  B->pool = &E->pool;
+  B->bracket_rows = -1;
+  B->last_used = E->switches;
+  editorJournalInit(&B->journal);
+
+  E->buffers = realloc(E->buffers, sizeof(struct editorBuffer *) * (E->numbuffers + 1));
+  E->buffers[E->numbuffers++] = B;
+  return B;
+}
+
+// Switching only swaps the current pointer: rows keep their render and highlight caches
+void editorBufferSwitch(struct editorConfig *E, int idx) {
+  if (idx < 0 || idx >= E->numbuffers || idx == E->current) return;
+
+  // Search highlighting belongs to the buffer being left
+  if (E->find.match_len) {
+    E->find.match_len = 0;
+    E->buf->version++;
+  }
+  if (E->brackets.shown) {
+    E->brackets.shown = 0;
+    E->buf->version++;
+  }
+  editorSelectionClear(E);
+
+  E->buf->last_used = ++E->switches;
+  E->current = idx;
+  E->buf = E->buffers[idx];
+  E->buf->last_used = E->switches;
+  E->win->buf = E->buf;
+  E->buf->evicted = 0;  // Its rows restore their caches as they are drawn or searched
+
+  editorEvictIdleBuffers(E);
+}
+
+void editorBufferClose(struct editorConfig *E, int idx) {
+  if (idx < 0 || idx >= E->numbuffers) return;
+  if (E->selection.buf == E->buffers[idx]) editorSelectionClear(E);
+
+  if (E->numbuffers == 1) {
+    // Keep the invariant of one buffer by replacing the last one with an empty buffer
+    struct editorBuffer *old = E->buffers[0];
+    E->numbuffers = 0;
+    E->buf = editorBufferNew(E);
+    E->current = 0;
+    editorWindowsReplaceBuffer(E, old, E->buf);
+    editorWatchRemove(E, old);
+    editorBufferFree(old);
+    return;
+  }
+
+  if (idx == E->current) editorBufferSwitch(E, idx == 0 ? 1 : idx - 1);
+  editorWindowsReplaceBuffer(E, E->buffers[idx], E->buf);
+
+  editorWatchRemove(E, E->buffers[idx]);
+  editorBufferFree(E->buffers[idx]);
+  memmove(&E->buffers[idx], &E->buffers[idx + 1],
+          sizeof(struct editorBuffer *) * (E->numbuffers - idx - 1));
+  E->numbuffers--;
+  if (E->current > idx) E->current--;
+}
+
+// Drops the render and highlight caches of every row; `chars` and `hl_open_comment` are kept
+void editorBufferEvict(struct editorBuffer *B) {
+  if (B->pager) return;  // Holds only a screenful of rows anyway
+  editorHighlighterFinish(B);
+  for (int j = 0; j < B->numrows; j++) {
+    erow *row = &B->row[j];
+    if (!row->shared) poolFree(B->pool, row->render);
+    poolFree(B->pool, row->hl);
+    row->render = NULL;
+    row->shared = 0;
+    row->hl = NULL;
+    row->nhl = 0;
+    row->rsize = 0;
+  }
+  B->evicted = 1;
+}
+
+// Evicts least recently used idle buffers until the pool is back under its limit
+void editorEvictIdleBuffers(struct editorConfig *E) {
+  while (E->pool.in_use > E->pool.limit) {
+    struct editorBuffer *lru = NULL;
+
+    for (int j = 0; j < E->numbuffers; j++) {
+      struct editorBuffer *B = E->buffers[j];
+      if (B->evicted || editorBufferVisible(E, B)) continue;
+      if (lru == NULL || B->last_used < lru->last_used) lru = B;
+    }
+
+    if (lru == NULL) break;
+    editorBufferEvict(lru);
+  }
+
+  // Blocks freed by eviction are only worth caching while there is room for them
+  if (E->pool.in_use + E->pool.cached > E->pool.limit) poolTrim(&E->pool);
+}
+
+int editorAnyDirty(struct editorConfig *E) {
+  for (int j = 0; j < E->numbuffers; j++) {
+    if (E->buffers[j]->dirty) return 1;
+  }
+  return 0;
+}
+
+// Points the buffer at another file. A buffer that already had one must have its watch removed
+// first with `editorWatchRemove()`.
+void editorSetFilename(struct editorBuffer *B, const char *filename) {
+  free(B->filename);  // Free memory pointed to before reassigning with pointer from `strdup()`
+  B->filename = strdup(filename);
+
+  editorJournalSetFilename(&B->journal, filename);
+  editorSelectSyntaxHighlight(B);
+  B->compression = editorCompressionForName(filename);
+
+  B->disk.known = 0;  // Another file, in a directory that may not be watched yet
+  B->disk.wd = 0;
+}
+
+/*** file i/o ***/
+
+char *editorRowsToString(struct editorBuffer *B, size_t *buflen) {
+  size_t totlen = 0;
+  for (int j = 0; j < B->numrows; j++) totlen += (size_t)B->row[j].size + 1;
+  *buflen = totlen;
+
+  char *buf = malloc(totlen ? totlen : 1);
+  if (buf == NULL) return NULL;
+  char *p = buf;
+  for (int j = 0; j < B->numrows; j++) {
+    memcpy(p, B->row[j].chars, B->row[j].size);
+    p += B->row[j].size;
+    *p = '\n';
+    p++;
+  }
+
+  return buf;
+}
+
+// Writes all `len` bytes, through short writes and interrupted ones. Returns -1 with `errno` set
+// on failure.
+int editorWriteAll(int fd, const char *s, size_t len) {
+  while (len > 0) {
+    ssize_t n = write(fd, s, len);
+    if (n == -1 && errno == EINTR) continue;
+    if (n == -1) return -1;
+    s += n;
+    len -= n;
+  }
+  return 0;
+}
+
+// Passes the rows to `out` a block at a time, so saving never holds a second copy of the file.
+// Returns the bytes passed, or -1 as soon as `out` fails.
+long long editorStreamRows(struct editorBuffer *B, int (*out)(void *ctx, const char *s, size_t len), void *ctx) {
+  char *block = malloc(WRITE_BLOCK);
+  size_t used = 0;
+  long long written = 0;
+  if (block == NULL) return -1;
+
+  for (int j = 0; j <= B->numrows; j++) {
+    erow *row = j < B->numrows ? &B->row[j] : NULL;
+    size_t len = row ? (size_t)row->size + 1 : 0;
+
+    if (row == NULL || used + len > WRITE_BLOCK) {
+      if (used > 0 && out(ctx, block, used) == -1) break;
+      written += used;
+      used = 0;
+    }
+    if (row == NULL) {
+      free(block);
+      return written;
+    }
+
+    if (len > WRITE_BLOCK) {  // A row bigger than the block goes out on its own
+      if (out(ctx, row->chars, row->size) == -1 || out(ctx, "\n", 1) == -1) break;
+      written += len;
+      continue;
+    }
+    memcpy(&block[used], row->chars, row->size);
+    block[used + row->size] = '\n';
+    used += len;
+  }
+
+  free(block);
+  return -1;
+}
+
+static int writeRowsTo(void *ctx, const char *s, size_t len) {
+  return editorWriteAll(*(int *)ctx, s, len);
+}
+
+// Writes the rows to `fd`. Returns the bytes written, or -1 with `errno` set.
+long long editorWriteRows(struct editorBuffer *B, int fd) {
+  return editorStreamRows(B, writeRowsTo, &fd);
+}
+
+// Returns -1 with `errno` set if the file can't be opened
+int editorOpen(struct editorBuffer *B, char *filename) {
+  TRACE_BEGIN("editorOpen");
+  editorSetFilename(B, filename);
+
+  FILE *fp = fopen(filename, "r");
+  if (!fp) {
+    TRACE_END("editorOpen");
+    return -1;
+  }
+
+  struct editorReader *R = editorReaderOpen(fp);
+  if (R == NULL) {
+    TRACE_END("editorOpen");
+    return -1;
+  }
+  B->compression = editorReaderCompression(R);
+
+  char *line;
+  ssize_t linelen;
+
+  B->journal.suspended++;  // Loading is not an edit
+
+  // Plain regular files are indexed on all cores; pipes and compressed files are streamed
+  if (B->compression != COMPRESS_NONE || editorIndexFile(B, fileno(fp)) == -1) {
+    while ((linelen = editorReaderLine(R, &line)) != -1) editorInsertRow(B, B->numrows, line, linelen);
+    B->truncated = editorReaderError(R);
+  }
+
+  editorReaderClose(R);
+  B->journal.suspended--;
+  editorOpenFinish(B);
+  TRACE_END("editorOpen");
+  return 0;
+}
+
+// Called once all of the file's rows are in the buffer
+void editorOpenFinish(struct editorBuffer *B) {
+  B->dirty = 0;
+  editorDiskRecord(B);
+
+  // Unsaved edits from a session that died with this file open
+  B->recovered = editorJournalReplay(B);
+  B->dirty = B->recovered;
+}
+
+// Writes the current buffer to its `filename`, which the caller must have set; returns -1 on failure
+int editorSave(struct editorConfig *E) {
+  if (E->buf->pager) {
+    editorSetStatusMessage(E, "Opened read-only with -R; can't save");
+    return -1;
+  }
+  if (E->buf->loader || E->buf->pipe) {
+    editorSetStatusMessage(E, "Can't save while the file is still loading");
+    return -1;
+  }
+  if (E->buf->saver) {
+    editorSetStatusMessage(E, "Still saving %.20s", E->buf->filename);
+    return -1;
+  }
+
+  // Someone else wrote the file since it was loaded or saved: only overwrite it when asked twice
+  struct editorDisk *D = &E->buf->disk;
+  if (D->changed == 0 && editorDiskChanged(E->buf)) D->changed = 1;
+  if (D->changed == 1) {
+    D->changed = 2;
+    editorSetStatusMessage(E, "WARNING!!! %.20s changed on disk. Press Ctrl-S again to overwrite it",
+                           E->buf->filename);
+    return -1;
+  }
+
+  if (E->buf->compression != COMPRESS_NONE) {
+    if (editorSaveAsync(E->buf) == -1) {
+      editorSetStatusMessage(E, "Can't save. I/O error: %s", strerror(errno));
+      return -1;
+    }
+    editorSetStatusMessage(E, "Compressing %.20s in the background...", E->buf->filename);
+    return 0;
+  }
+
+  TRACE_BEGIN("editorSave");
+  long long len = 0;
+  for (int j = 0; j < E->buf->numrows; j++) len += E->buf->row[j].size + 1;
+
+  int fd = open(E->buf->filename, O_RDWR | O_CREAT, 0644);
+  if (fd != -1) {
+    if (ftruncate(fd, len) != -1) {
+      // The journal goes only once the file it would recover is on disk
+      if (editorWriteRows(E->buf, fd) == len && fsync(fd) != -1) {
+        close(fd);
+        E->buf->dirty = 0;
+        editorJournalDiscard(&E->buf->journal);
+        editorDiskRecord(E->buf);
+        editorSetStatusMessage(E, "%lld bytes written to disk", len);
+        TRACE_END("editorSave");
+        return 0;
+      }
+    }
+    close(fd);
+  }
+
+  editorSetStatusMessage(E, "Can't save. I/O error: %s", strerror(errno));
+  TRACE_END("editorSave");
+  return -1;
+}
+
+/*** idle ***/
+
+// Picks up the results of background work; cheap enough to call before every refresh.
+// Returns non-zero if the screen needs to be refreshed.
+int editorPoll(struct editorConfig *E) {
+  int changed = 0;
+
+  for (int j = 0; j < E->numbuffers; j++) {
+    struct editorBuffer *B = E->buffers[j];
+    int loading = B->loader != NULL;
+
+    changed |= editorLoaderPoll(B);
+    changed |= editorPipePoll(B);
+    if (loading && B->loader == NULL && B->truncated) {
+      editorSetStatusMessage(E, "%.20s is truncated or corrupt; only %d lines could be read",
+                             B->filename, B->numrows);
+    } else if (loading && B->loader == NULL && B->recovered) {
+      editorSetStatusMessage(E, "Recovered %d unsaved edits to %.20s from the journal", B->recovered,
+                             B->filename);
+    }
+    changed |= editorSaverPoll(E, B);
+    changed |= editorHighlighterPoll(B);
+  }
+  changed |= editorWatchPoll(E);
+  return changed;
+}
+
+int editorLoading(struct editorConfig *E) {
+  for (int j = 0; j < E->numbuffers; j++) {
+    if (E->buffers[j]->loader || E->buffers[j]->pipe) return 1;
+  }
+  return 0;
+}
+
+// Work for when no key has arrived within the terminal's read timeout. Returns non-zero if
+// the screen needs to be refreshed.
+int editorIdle(struct editorConfig *E) {
+  int changed = editorPoll(E);
+  for (int j = 0; j < E->numbuffers; j++) editorJournalFlush(&E->buffers[j]->journal);
+  editorCompact(E);
+  return changed;
+}
+
+// Moves rows out of mostly empty slabs, once editing has freed enough of the pool for that to
+// release memory. Pagers' few rows stay where they are, as do rows being re-highlighted.
+void editorCompact(struct editorConfig *E) {
+  struct editorPool *p = &E->pool;
+  if (!poolCompactBegin(p)) return;
+  TRACE_BEGIN("editorCompact");
+
+  for (int j = 0; j < E->numbuffers; j++) {
+    struct editorBuffer *B = E->buffers[j];
+    if (B->pager || B->highlighter || B->saver) continue;
+
+    for (int y = 0; y < B->numrows; y++) {
+      erow *row = &B->row[y];
+      row->chars = poolMove(p, row->chars);
+      row->render = row->shared ? row->chars : poolMove(p, row->render);
+      row->hl = poolMove(p, row->hl);
+    }
+  }
+  if (E->clipboard.src == NULL) {
+    for (int k = 0; k < E->clipboard.numrows; k++) {
+      E->clipboard.rows[k].chars = poolMove(p, E->clipboard.rows[k].chars);
+    }
+  }
+
+  poolCompactEnd(p);
+  TRACE_END("editorCompact");
+}
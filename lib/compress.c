@@ -0,0 +1,431 @@
+/*** includes ***/
+
+// Feature test macros (portability): https://www.gnu.org/software/libc/manual/html_node/Feature-Test-Macros.html
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef EDITOR_ZSTD
+#include <zstd.h>
+#endif
+
+#include "editor.h"
+
+/*** compression ***/
+
+// Compressed files are recognised by their magic bytes and decompressed a chunk at a time
+// straight into rows, so opening one needs no temporary file and no more memory than the
+// decompressed text. Saving streams the rows through the compressor on a background thread.
+
+#define COMPRESS_CHUNK (64 * 1024)
+
+// Compression a new file gets from its name; opening an existing file goes by its contents
+int editorCompressionForName(const char *filename) {
+  const char *ext = strrchr(filename, '.');
+  if (ext && !strcmp(ext, ".gz")) return COMPRESS_GZIP;
+  if (ext && !strcmp(ext, ".zst")) return COMPRESS_ZSTD;
+  return COMPRESS_NONE;
+}
+
+/*** reader ***/
+
+// Reads lines from a file, plain or compressed, a chunk at a time
+struct editorReader {
+  FILE *fp;
+  int compression;
+  unsigned char in[COMPRESS_CHUNK];  // File bytes not yet decompressed
+  size_t inpos, inlen;
+  int in_eof;
+  char *buf;  // Decompressed bytes; lines are returned from here
+  size_t bufstart, buflen, bufcap;
+  size_t scanned;  // Bytes after `bufstart` known to hold no newline
+  int eof;
+  int error;
+  long long offset;  // File bytes consumed
+  int stream_end;    // The current gzip member or zstd frame is complete
+  z_stream gz;
+#ifdef EDITOR_ZSTD
+  ZSTD_DCtx *zs;
+#endif
+};
+
+// Takes ownership of `fp`. Returns NULL with `errno` set if the file is compressed in a format
+// this build can't read.
+struct editorReader *editorReaderOpen(FILE *fp) {
+  struct editorReader *R = calloc(1, sizeof(struct editorReader));
+  R->fp = fp;
+  R->inlen = fread(R->in, 1, sizeof(R->in), fp);
+  R->in_eof = R->inlen < sizeof(R->in);
+
+  if (R->inlen >= 2 && R->in[0] == 0x1f && R->in[1] == 0x8b) {
+    R->compression = COMPRESS_GZIP;
+    // 15 + 32: largest window, with a gzip or zlib header detected automatically
+    if (inflateInit2(&R->gz, 15 + 32) != Z_OK) goto fail;
+  } else if (R->inlen >= 4 && !memcmp(R->in, "\x28\xb5\x2f\xfd", 4)) {
+    R->compression = COMPRESS_ZSTD;
+#ifdef EDITOR_ZSTD
+    if ((R->zs = ZSTD_createDCtx()) == NULL) goto fail;
+#else
+    errno = ENOTSUP;  // Built without zstd
+    goto fail;
+#endif
+  }
+  return R;
+
+fail:
+  free(R);
+  fclose(fp);
+  return NULL;
+}
+
+void editorReaderClose(struct editorReader *R) {
+  if (R == NULL) return;
+  if (R->compression == COMPRESS_GZIP) inflateEnd(&R->gz);
+#ifdef EDITOR_ZSTD
+  if (R->zs) ZSTD_freeDCtx(R->zs);
+#endif
+  fclose(R->fp);
+  free(R->buf);
+  free(R);
+}
+
+int editorReaderCompression(struct editorReader *R) {
+  return R->compression;
+}
+
+long long editorReaderOffset(struct editorReader *R) {
+  return __atomic_load_n(&R->offset, __ATOMIC_RELAXED);
+}
+
+// Non-zero if the file ended in the middle of a compressed stream or the stream is corrupt
+int editorReaderError(struct editorReader *R) {
+  return R->error;
+}
+
+// Decompresses at least one more byte into `buf`, or sets `eof`
+static void editorReaderFill(struct editorReader *R) {
+  if (R->bufstart > 0) {
+    memmove(R->buf, &R->buf[R->bufstart], R->buflen - R->bufstart);
+    R->buflen -= R->bufstart;
+    R->bufstart = 0;
+  }
+  if (R->bufcap - R->buflen < COMPRESS_CHUNK) {
+    R->bufcap = R->bufcap ? R->bufcap * 2 : 2 * COMPRESS_CHUNK;
+    R->buf = realloc(R->buf, R->bufcap);
+  }
+
+  size_t before = R->buflen;
+  while (R->buflen == before && !R->eof) {
+    if (R->inpos == R->inlen && !R->in_eof) {
+      R->inlen = fread(R->in, 1, sizeof(R->in), R->fp);
+      R->inpos = 0;
+      R->in_eof = R->inlen < sizeof(R->in);
+    }
+    size_t avail = R->inlen - R->inpos;
+    size_t space = R->bufcap - R->buflen;
+    size_t used = 0;
+
+    if (R->compression == COMPRESS_NONE) {
+      used = avail < space ? avail : space;
+      memcpy(&R->buf[R->buflen], &R->in[R->inpos], used);
+      R->buflen += used;
+      if (used == 0 && R->in_eof) R->eof = 1;
+    } else if (R->compression == COMPRESS_GZIP) {
+      if (R->stream_end && avail > 0) {
+        inflateReset(&R->gz);  // Concatenated members, as `gzip` writes for `cat a.gz b.gz`
+        R->stream_end = 0;
+      }
+      R->gz.next_in = &R->in[R->inpos];
+      R->gz.avail_in = avail;
+      R->gz.next_out = (unsigned char *)&R->buf[R->buflen];
+      R->gz.avail_out = space;
+
+      int ret = inflate(&R->gz, Z_NO_FLUSH);
+      used = avail - R->gz.avail_in;
+      R->buflen += space - R->gz.avail_out;
+
+      if (ret == Z_STREAM_END) {
+        R->stream_end = 1;
+      } else if (ret != Z_OK && !(ret == Z_BUF_ERROR && avail == 0)) {
+        R->error = R->eof = 1;
+      }
+      if (used == 0 && avail == 0 && R->in_eof) {
+        R->eof = 1;
+        if (!R->stream_end) R->error = 1;  // Truncated
+      }
+    } else {
+#ifdef EDITOR_ZSTD
+      ZSTD_inBuffer in = {&R->in[R->inpos], avail, 0};
+      ZSTD_outBuffer out = {&R->buf[R->buflen], space, 0};
+
+      size_t ret = ZSTD_decompressStream(R->zs, &out, &in);
+      used = in.pos;
+      R->buflen += out.pos;
+
+      if (ZSTD_isError(ret)) {
+        R->error = R->eof = 1;
+      } else {
+        R->stream_end = (ret == 0);
+      }
+      if (used == 0 && out.pos == 0 && avail == 0 && R->in_eof) {
+        R->eof = 1;
+        if (!R->stream_end) R->error = 1;  // Truncated
+      }
+#endif
+    }
+
+    R->inpos += used;
+    __atomic_add_fetch(&R->offset, used, __ATOMIC_RELAXED);
+  }
+}
+
+// Points `line` at the next line, without its line ending, and returns its length; -1 at the
+// end of the file. The line stays valid until the next call.
+ssize_t editorReaderLine(struct editorReader *R, char **line) {
+  while (1) {
+    char *s = &R->buf[R->bufstart];
+    size_t avail = R->buflen - R->bufstart;
+    char *nl = memchr(&s[R->scanned], '\n', avail - R->scanned);
+
+    if (nl || R->eof) {
+      if (nl == NULL && avail == 0) return -1;
+
+      size_t len = nl ? (size_t)(nl - s) : avail;
+      R->bufstart += nl ? len + 1 : len;
+      R->scanned = 0;
+      while (len > 0 && s[len - 1] == '\r') len--;
+      *line = s;
+      return len;
+    }
+
+    R->scanned = avail;
+    editorReaderFill(R);
+  }
+}
+
+/*** saver ***/
+
+// A compressed save streams the rows through the compressor on a background thread, a block at
+// a time, so it needs no copy of the text. The buffer is read-only until it finishes. The output
+// goes to `.<name>.save` next to the file and replaces the file by a `rename()` once it is on
+// disk, so a crash or an I/O error midway leaves the old file and the journal as they were.
+
+struct editorSaver {
+  pthread_t thread;
+  int threaded;
+  struct editorBuffer *B;
+  int fd;
+  char *path;  // The file being written, renamed over the buffer's once complete
+  int compression;
+  z_stream z;
+#ifdef EDITOR_ZSTD
+  ZSTD_CCtx *cctx;
+#endif
+  long long len;  // Bytes of text
+  long long written;
+  int error;  // `errno` of the failure, if any
+  int finished;
+};
+
+// `.<name>.save` next to the file
+static char *saverPath(const char *filename) {
+  const char *slash = strrchr(filename, '/');
+  int dirlen = slash ? slash - filename + 1 : 0;
+  char *path = malloc(strlen(filename) + 7);
+
+  memcpy(path, filename, dirlen);
+  strcpy(&path[dirlen], ".");
+  strcat(path, &filename[dirlen]);
+  strcat(path, ".save");
+  return path;
+}
+
+static int editorSaverWrite(struct editorSaver *S, unsigned char *out, size_t len) {
+  if (editorWriteAll(S->fd, (const char *)out, len) == -1) {
+    S->error = errno;
+    return -1;
+  }
+  S->written += len;
+  return 0;
+}
+
+// Compresses `len` bytes of text into the file; `end` finishes the stream
+static int editorSaverGzip(struct editorSaver *S, const char *in, size_t len, int end) {
+  unsigned char out[COMPRESS_CHUNK];
+  z_stream *z = &S->z;
+  int ret;
+
+  z->next_in = (unsigned char *)in;
+  z->avail_in = len;
+  do {
+    z->next_out = out;
+    z->avail_out = sizeof(out);
+    ret = deflate(z, end ? Z_FINISH : Z_NO_FLUSH);
+    if (ret == Z_STREAM_ERROR) {
+      S->error = EIO;
+      return -1;
+    }
+    if (editorSaverWrite(S, out, sizeof(out) - z->avail_out) == -1) return -1;
+  } while (end ? ret == Z_OK : z->avail_out == 0);
+  return 0;
+}
+
+#ifdef EDITOR_ZSTD
+static int editorSaverZstd(struct editorSaver *S, const char *in, size_t len, int end) {
+  unsigned char out[COMPRESS_CHUNK];
+  ZSTD_inBuffer i = {in, len, 0};
+  size_t remaining;
+
+  do {
+    ZSTD_outBuffer o = {out, sizeof(out), 0};
+    remaining = ZSTD_compressStream2(S->cctx, &o, &i, end ? ZSTD_e_end : ZSTD_e_continue);
+    if (ZSTD_isError(remaining)) {
+      S->error = EIO;
+      return -1;
+    }
+    if (editorSaverWrite(S, out, o.pos) == -1) return -1;
+  } while (end ? remaining != 0 : i.pos < i.size);
+  return 0;
+}
+#endif
+
+static int editorSaverCompress(void *ctx, const char *in, size_t len) {
+  struct editorSaver *S = ctx;
+#ifdef EDITOR_ZSTD
+  if (S->compression == COMPRESS_ZSTD) return editorSaverZstd(S, in, len, in == NULL);
+#endif
+  return editorSaverGzip(S, in, len, in == NULL);
+}
+
+static void *editorSaverWorker(void *arg) {
+  struct editorSaver *S = arg;
+  int ready = 0;
+
+#ifdef EDITOR_ZSTD
+  if (S->compression == COMPRESS_ZSTD) ready = (S->cctx = ZSTD_createCCtx()) != NULL;
+#endif
+  // 15 + 16: largest window, with a gzip header and trailer
+  if (S->compression == COMPRESS_GZIP) {
+    ready = deflateInit2(&S->z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+  }
+
+  if (!ready) {
+    S->error = ENOMEM;
+  } else if ((S->len = editorStreamRows(S->B, editorSaverCompress, S)) != -1) {
+    editorSaverCompress(S, NULL, 0);
+  } else if (S->error == 0) {
+    S->error = ENOMEM;
+  }
+
+#ifdef EDITOR_ZSTD
+  ZSTD_freeCCtx(S->cctx);
+#endif
+  if (S->compression == COMPRESS_GZIP && ready) deflateEnd(&S->z);
+
+  // The new file must be on disk before it replaces the old one
+  if (S->error == 0 && fsync(S->fd) == -1) S->error = errno;
+  if (close(S->fd) == -1 && S->error == 0) S->error = errno;
+  if (S->error == 0 && rename(S->path, S->B->filename) == -1) S->error = errno;
+  if (S->error) unlink(S->path);
+
+  __atomic_store_n(&S->finished, 1, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+// Starts writing the buffer to its file, compressed, on a background thread. Returns -1 with
+// `errno` set if the file can't be written.
+int editorSaveAsync(struct editorBuffer *B) {
+#ifndef EDITOR_ZSTD
+  if (B->compression == COMPRESS_ZSTD) {
+    errno = ENOTSUP;  // Built without zstd
+    return -1;
+  }
+#endif
+
+  // The file keeps its permissions across the rename
+  struct stat st;
+  mode_t mode = stat(B->filename, &st) == 0 ? st.st_mode & 07777 : 0644;
+
+  char *path = saverPath(B->filename);
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  if (fd == -1 || fchmod(fd, mode) == -1) {
+    int saved = errno;
+    if (fd != -1) {
+      close(fd);
+      unlink(path);
+    }
+    free(path);
+    errno = saved;
+    return -1;
+  }
+
+  struct editorSaver *S = calloc(1, sizeof(struct editorSaver));
+  S->B = B;
+  S->fd = fd;
+  S->path = path;
+  S->compression = B->compression;
+  B->saver = S;  // Read-only from here, as the rows are read as they are
+
+  S->threaded = pthread_create(&S->thread, NULL, editorSaverWorker, S) == 0;
+  if (!S->threaded) editorSaverWorker(S);  // No thread to spare: compress here instead
+  return 0;
+}
+
+static void editorSaverFree(struct editorSaver *S) {
+  free(S->path);
+  free(S);
+}
+
+// Reports a finished background save. Returns non-zero if one finished.
+int editorSaverPoll(struct editorConfig *E, struct editorBuffer *B) {
+  struct editorSaver *S = B->saver;
+  if (S == NULL || !__atomic_load_n(&S->finished, __ATOMIC_ACQUIRE)) return 0;
+
+  if (S->threaded) pthread_join(S->thread, NULL);
+  B->saver = NULL;
+
+  // The journal still recovers the buffer until the new file has replaced the old one
+  if (S->error) {
+    editorSetStatusMessage(E, "Can't save %.20s. I/O error: %s", B->filename, strerror(S->error));
+  } else {
+    B->dirty = 0;
+    editorJournalDiscard(&B->journal);
+    editorDiskRecord(B);
+    editorSetStatusMessage(E, "%lld bytes written to disk (%lld compressed)", S->len, S->written);
+  }
+
+  editorSaverFree(S);
+  return 1;
+}
+
+// Waits for a background save to finish, e.g. before the buffer is freed
+void editorSaverWait(struct editorBuffer *B) {
+  struct editorSaver *S = B->saver;
+  if (S == NULL) return;
+
+  if (S->threaded) pthread_join(S->thread, NULL);
+  editorSaverFree(S);
+  B->saver = NULL;
+}
+
+// Waits for a background save and reports it. Returns -1 if it failed.
+int editorSaverFinish(struct editorConfig *E, struct editorBuffer *B) {
+  struct editorSaver *S = B->saver;
+  if (S == NULL) return 0;
+
+  if (S->threaded) pthread_join(S->thread, NULL);
+  S->threaded = 0;
+  int error = S->error;
+  editorSaverPoll(E, B);
+  return error ? -1 : 0;
+}
@@ -0,0 +1,607 @@
+#ifndef EDITOR_H
+#define EDITOR_H
+
+/*** includes ***/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+
+/*** defines ***/
+
+#define EDITOR_VERSION "0.0.1"
+#define EDITOR_TAB_STOP 8
+#define EDITOR_QUIT_TIMES 3
+
+#define EDITOR_TRACE_EVENTS (1 << 16)  // Ring buffer capacity; must be a power of 2
+
+#define EDITOR_POOL_CLASSES 13                // Power-of-two size classes, 16 bytes to 64 KiB
+#define EDITOR_POOL_LIMIT (256u * 1024 * 1024)  // Bytes in use before idle buffers are evicted
+
+#define EDITOR_MAX_WINDOWS 64
+
+#define CTRL_KEY(k) ((k) & 0x1f)
+
+enum editorKey {
+  BACKSPACE = 127,
+  ARROW_LEFT = 1000,
+  ARROW_RIGHT,
+  ARROW_UP,
+  ARROW_DOWN,
+  DEL_KEY,
+  HOME_KEY,
+  END_KEY,
+  PAGE_UP,
+  PAGE_DOWN,
+  SHIFT_TAB,
+};
+
+enum editorHighlight {
+  HL_NORMAL = 0,
+  HL_COMMENT,
+  HL_MLCOMMENT,
+  HL_KEYWORD1,
+  HL_KEYWORD2,
+  HL_STRING,
+  HL_NUMBER,
+  HL_MATCH,
+  HL_BRACKET,  // The bracket under the cursor and its partner
+  HL_SELECTION,
+};
+
+#define HL_CLASSES (HL_SELECTION + 1)
+
+// Colours are `EDITOR_COLOR_DEFAULT`, a palette index (0-255) or a 24-bit `EDITOR_RGB()`
+#define EDITOR_COLOR_DEFAULT -1
+#define EDITOR_RGB(r, g, b) (0x1000000 | (r) << 16 | (g) << 8 | (b))
+
+#define STYLE_BOLD (1 << 0)
+#define STYLE_UNDERLINE (1 << 1)
+#define STYLE_INVERSE (1 << 2)
+
+enum editorCompression {
+  COMPRESS_NONE = 0,
+  COMPRESS_GZIP,
+  COMPRESS_ZSTD,
+};
+
+#define HL_HIGHLIGHT_NUMBERS (1 << 0)
+#define HL_HIGHLIGHT_STRINGS (1 << 1)
+#define HL_IGNORE_CASE (1 << 2)  // Keywords match in any case
+
+/*** data ***/
+
+struct editorSyntax {
+  char *filetype;
+  char **filematch;
+  char **keywords;
+  char *singleline_comment_start;  // To disable, set to NULL or ""
+  char *multiline_comment_start;
+  char *multiline_comment_end;
+  int flags;
+  char *quotes;  // Characters that open and close strings; NULL for `"` and `'`
+  struct editorLexer *lexer;  // Compiled from the above when the filetype is first used
+};
+
+// One move of a compiled lexer: the state after a byte and how the byte is highlighted. Keywords
+// and comment delimiters are recognised at their end, so `back` bytes before it can be recoloured.
+struct editorLexMove {
+  uint16_t next;
+  uint8_t hl;  // `enum editorHighlight` of the byte in the low nibble, of the `back` bytes in the high one
+  uint8_t back;
+};
+
+// A syntax compiled into a DFA over classes of bytes, so highlighting is a table lookup per byte
+struct editorLexer {
+  int nstates;
+  int nclasses;  // The last class is the end of the row
+  int comment;   // Start state inside a multi-line comment; outside one it is 0
+  unsigned char classes[256];
+  struct editorLexMove *moves;  // `nstates` rows of `nclasses` moves
+  unsigned char *open;          // Whether each state is inside a multi-line comment
+};
+
+// A run of `len` rendered columns from `start` in one `enum editorHighlight` class. Columns no
+// span covers are `HL_NORMAL`.
+struct editorSpan {
+  int start;
+  unsigned short len;  // Longer runs take several spans
+  unsigned char hl;
+};
+
+#define EDITOR_SPAN_MAX 0xffff
+
+// A row's brackets outside strings and comments, as the change in nesting depth across it: `net`
+// is opening minus closing brackets, `low` the lowest depth reached from the row's start (0 if
+// it never dips below it)
+struct editorBracketSum {
+  int net;
+  int low;
+};
+
+typedef struct erow {
+  int idx;
+  int size;
+  int rsize;
+  int nhl : 30;
+  unsigned int hl_open_comment : 1;
+  unsigned int shared : 1;  // `render` is `chars` itself: the row has no tabs to expand
+  char *chars;
+  char *render;
+  struct editorSpan *hl;  // Highlighted runs of `render`, in column order
+  struct editorBracketSum brackets;  // Kept, like `hl_open_comment`, when the row is evicted
+} erow;
+
+// Incremental search state, kept between calls to `editorFindCallback()`. The current match is
+// drawn over the row's highlighting rather than written into it.
+struct editorFind {
+  int last_match;
+  int direction;
+  int match_line;  // Row of the current buffer holding the match
+  int match_rx;    // Rendered column where it starts
+  int match_len;   // 0 when nothing is highlighted
+  int misses;      // Searches that found nothing, so a macro can stop at the last match
+  int typing;      // The query has had a key typed since the prompt opened
+};
+
+// Recorded keys, and where a replay of them has got to
+struct editorMacro {
+  int *keys;
+  int len, cap;
+  int recording;
+  int playing;  // Keys come from `keys`, not the terminal, and nothing is drawn
+  int pos;
+  int misses;  // `find.misses` when the run started; a failed search ends the run there
+};
+
+// The bracket under the cursor in the current buffer and its partner, drawn over the rows'
+// highlighting like the search match
+struct editorBracketMatch {
+  int line, rx;
+  int match_line, match_rx;
+  int shown;  // 0 when nothing is highlighted
+};
+
+// The region between the mark and the cursor, while one is being selected. `y0` to `x1` are
+// where it was last drawn, so moving the cursor repaints only when the region changes.
+struct editorSelection {
+  struct editorBuffer *buf;  // Buffer the mark was set in; NULL when nothing is selected
+  int cx, cy;                // The mark
+  int y0, x0, y1, x1;
+  int shown;
+};
+
+// Text cut or copied, shared by all buffers, as lines: the first may start and the last end in
+// the middle of a row. A copy refers to the rows of its buffer until one of them is about to
+// change, and only then is the text copied out. A cut moves the rows themselves.
+struct editorClipboard {
+  erow *rows;  // The lines, once the clipboard holds them itself
+  int numrows;
+  struct editorBuffer *src;  // Otherwise the buffer whose rows hold them
+  int y0, x0, y1, x1;        // From column `x0` of row `y0` to before column `x1` of row `y1`
+};
+
+struct abuf {
+  char *b;
+  int len;
+};
+
+#define ABUF_INIT {.b = NULL, .len = 0}
+
+// Append-only log of a buffer's unsaved edits, for crash recovery
+struct editorJournal {
+  int fd;               // -1 until the first edit after a load or save
+  char *path;
+  struct abuf pending;  // Records not yet written
+  int suspended;        // Loading, replaying or batch mode: edits are not recorded, nor is a
+                        // journal on disk replayed or removed
+};
+
+// The file as it was when the buffer last matched it, to tell other processes' writes from ours
+struct editorDisk {
+  int known;  // The fields below describe the file; 0 for a buffer never loaded or saved
+  dev_t dev;
+  ino_t ino;
+  off_t size;
+  time_t mtime;
+  long mtime_nsec;
+  uint64_t tail_hash;  // Hash of the file's last `tail_len` bytes, to recognise appends
+  int tail_len;
+  int eol;             // The file ends with a newline
+  int wd;              // inotify watch on the file's directory; 0 if not yet watched, -1 if polled
+  int event;           // A change was reported and not yet looked at
+  time_t checked;      // Last `stat()` when there is no watch
+  int changed;         // Changed under unsaved edits: 1, or 2 once a save has been refused
+};
+
+// Allocator for row storage, shared by all buffers of an editor
+struct editorPool {
+  struct poolSlab *slabs[EDITOR_POOL_CLASSES];    // Slabs of each small class
+  struct poolSlab *current[EDITOR_POOL_CLASSES];  // Slab the next block of a class comes from
+  void *free[EDITOR_POOL_CLASSES];  // Free list per larger size class
+  int full[EDITOR_POOL_CLASSES];    // No slab of a small class but the current one has room
+  size_t in_use;                    // Bytes handed out, counted by block capacity
+  size_t cached;                    // Bytes free in slabs and on the free lists
+  size_t limit;                     // Soft limit; above it, idle buffers drop their render caches
+  size_t requested;                 // Bytes asked for by the blocks handed out
+  size_t slab_bytes;                // Bytes of slabs
+  size_t large_bytes;               // Bytes of blocks too big for slabs, in use or cached
+  size_t freed;                     // Bytes freed since the last compaction
+  char *region;                     // Mapped slabs not yet used, `region_left` of them
+  int region_left;
+};
+
+// Where the pool's memory goes, from `poolStats()`
+struct editorPoolStats {
+  size_t slabs;
+  size_t slab_bytes;
+  size_t large_bytes;
+  size_t in_use;      // Capacity of the blocks handed out
+  size_t requested;   // Bytes asked for; the rest of `in_use` is size-class slack
+  size_t fragmented;  // Free bytes in slabs that can't be released because they hold live blocks
+};
+
+// One open file: its rows, syntax state and cursor
+struct editorBuffer {
+  int cx, cy;
+  int rx;
+  int rowoff, coloff;
+  int numrows;
+  int rowcap;  // Rows allocated in `row`
+  erow *row;
+  int dirty;
+  char *filename;
+  struct editorSyntax *syntax;
+  int plain;  // Never given a filetype, as in batch mode where nothing is drawn
+  struct editorPool *pool;
+  struct editorLoader *loader;  // Non-NULL while the file is still loading in the background
+  struct editorPipe *pipe;      // Non-NULL while rows are still arriving through a pipe
+  struct editorSaver *saver;    // Non-NULL while a compressed save is being written
+  int compression;              // `enum editorCompression` of the file on disk
+  int truncated;                // Decompression stopped early; the rest of the file is missing
+  int follow;                   // Like `tail -f`: read-only, growing as the file does
+  struct editorPager *pager;    // Non-NULL for a read-only view of a mapped file (`-R`)
+  struct editorHighlighter *highlighter;  // Non-NULL while re-highlighting in the background
+  long long *line_offsets;      // Byte offset of every 256th row, for jumps to an offset
+  int line_offsets_valid;       // Leading entries of `line_offsets` that are up to date
+  int line_offsets_cap;
+  struct editorBracketSum *bracket_tree;  // Segment tree over the rows' `brackets`
+  int bracket_rows;                       // Rows `bracket_tree` covers; -1 when it must be rebuilt
+  struct editorClipboard *clipboard;      // Non-NULL while the clipboard refers to rows of this buffer
+  int evicted;              // `render` and `hl` were freed; rows rebuild them when next read
+  unsigned long last_used;  // Switch counter when the buffer was last current, for eviction
+  unsigned long version;    // Bumped whenever rows or their highlighting change
+  struct editorJournal journal;
+  int recovered;  // Edits replayed from a journal when the file was opened
+  struct editorDisk disk;
+};
+
+// A viewport onto a buffer. The active window's cursor and scroll offsets live in its buffer
+// while it has focus, so editing code only ever looks at the buffer.
+struct editorWindow {
+  struct editorBuffer *buf;
+  int cx, cy;
+  int rx;
+  int rowoff, coloff;
+  int top, left, rows, cols;  // Text area on screen, 0-based
+  int statusline;             // Has its own status line below the text area
+
+  // What the terminal shows for this window, so unchanged windows are not repainted
+  int drawn;
+  struct editorBuffer *drawn_buf;
+  unsigned long drawn_version;
+  int drawn_rowoff, drawn_coloff;
+};
+
+// Binary tree of splits; leaves hold windows
+struct editorLayout {
+  char split;  // 0 (leaf), 'h' (stacked, one above the other) or 'v' (side by side)
+  struct editorLayout *parent, *a, *b;
+  struct editorWindow *win;
+};
+
+// How text is drawn: colours and `STYLE_*` attributes
+struct editorStyle {
+  int fg, bg;
+  unsigned char attrs;
+};
+
+// A style per highlight class
+struct editorTheme {
+  const char *name;
+  struct editorStyle styles[HL_CLASSES];
+};
+
+// Editor context: every library call operates on an explicit handle instead of global state
+struct editorConfig {
+  int screenrows, screencols;
+  char statusmsg[80];
+  time_t statusmsg_time;
+  struct editorBuffer **buffers;
+  int numbuffers;
+  int current;              // Index of `buf` in `buffers`
+  struct editorBuffer *buf;  // Current buffer
+  unsigned long switches;
+  struct editorLayout *layout;
+  struct editorWindow *win;  // Active window; always shows `buf`
+  int relayout;              // Window geometry changed; recompute it and repaint everything
+  struct editorPool pool;
+  struct editorFind find;
+  struct editorBracketMatch brackets;
+  struct editorSelection selection;
+  struct editorClipboard clipboard;
+  struct editorMacro macro;
+  int watch_fd;  // inotify instance watching the buffers' files, or -1
+  const struct editorTheme *theme;
+};
+
+/*** trace ***/
+
+void traceInit(void);
+void traceRecord(const char *name, char phase);
+void traceFlush(void);
+
+#define TRACE_BEGIN(name) traceRecord(name, 'B')
+#define TRACE_END(name) traceRecord(name, 'E')
+
+/*** pool ***/
+
+void poolInit(struct editorPool *p, size_t limit);
+void *poolAlloc(struct editorPool *p, size_t size);
+void *poolRealloc(struct editorPool *p, void *ptr, size_t size);
+void poolFree(struct editorPool *p, void *ptr);
+void poolTrim(struct editorPool *p);
+void poolMerge(struct editorPool *dst, struct editorPool *src);
+int poolCompactBegin(struct editorPool *p);
+void *poolMove(struct editorPool *p, void *ptr);
+void poolCompactEnd(struct editorPool *p);
+void poolStats(struct editorPool *p, struct editorPoolStats *st);
+
+/*** append buffer ***/
+
+void abAppend(struct abuf *ab, const char *s, int len);
+void abFree(struct abuf *ab);
+
+/*** syntax highlighting ***/
+
+int is_separator(int c);
+int editorHighlightRow(struct editorPool *pool, struct editorSyntax *syntax, erow *row, int in_comment);
+void editorUpdateSyntax(struct editorBuffer *B, erow *row);
+void editorSelectSyntaxHighlight(struct editorBuffer *B);
+int editorSyntaxLoad(const char *dir, char *err, size_t errlen);
+
+/*** highlighter ***/
+
+void editorHighlighterStart(struct editorBuffer *B);
+int editorHighlighterPoll(struct editorBuffer *B);
+void editorHighlighterFinish(struct editorBuffer *B);
+void editorHighlighterCancel(struct editorBuffer *B);
+
+/*** theme ***/
+
+extern const struct editorStyle editorStyleDefault;
+
+const struct editorTheme *editorThemeDefault(void);
+int editorThemeSet(struct editorConfig *E, const char *name);
+void editorStyleApply(struct abuf *ab, const struct editorStyle *from, const struct editorStyle *to);
+
+/*** lexer ***/
+
+struct editorLexer *editorLexerCompile(struct editorSyntax *syntax, char *err, size_t errlen);
+void editorLexerFree(struct editorLexer *X);
+struct editorLexer *editorLexerLoad(const char *path, const struct stat *st);
+void editorLexerSave(const char *path, const struct stat *st, struct editorLexer *X);
+
+/*** row operations ***/
+
+int editorRowCxToRx(erow *row, int cx);
+int editorRowRxToCx(erow *row, int rx);
+void editorRenderRow(struct editorPool *pool, erow *row);
+void editorUpdateRow(struct editorBuffer *B, erow *row);
+void editorRowRestore(struct editorBuffer *B, erow *row);
+void editorRowsReserve(struct editorBuffer *B, int n);
+void editorInsertRow(struct editorBuffer *B, int at, char *s, size_t len);
+void editorInsertRows(struct editorBuffer *B, int at, erow *src, int n);
+void editorFreeRow(struct editorBuffer *B, erow *row);
+void editorDelRow(struct editorBuffer *B, int at);
+void editorDelRows(struct editorBuffer *B, int at, int n, erow *out);
+void editorRowInsertChar(struct editorBuffer *B, erow *row, int at, int c);
+void editorRowInsertString(struct editorBuffer *B, erow *row, int at, const char *s, size_t len);
+void editorRowAppendString(struct editorBuffer *B, erow *row, char *s, size_t len);
+void editorRowDelChar(struct editorBuffer *B, erow *row, int at);
+void editorRowDelChars(struct editorBuffer *B, erow *row, int at, int len);
+void editorRowTruncate(struct editorBuffer *B, erow *row, int size);
+int editorRowIndentWidth(erow *row);
+void editorIndentRows(struct editorBuffer *B, int at, int n, int dir);
+erow *editorRow(struct editorBuffer *B, int y);
+int editorBufferReadOnly(struct editorBuffer *B);
+
+/*** editor operations ***/
+
+void editorInsertChar(struct editorBuffer *B, int c);
+void editorInsertNewline(struct editorBuffer *B);
+void editorDelChar(struct editorBuffer *B);
+
+/*** selection ***/
+
+void editorSelectionStart(struct editorConfig *E);
+void editorSelectionClear(struct editorConfig *E);
+int editorSelectionBounds(struct editorConfig *E, int *y0, int *x0, int *y1, int *x1);
+void editorSelectionUpdate(struct editorConfig *E);
+int editorSelectionCut(struct editorConfig *E);
+int editorSelectionCopy(struct editorConfig *E);
+int editorSelectionIndent(struct editorConfig *E, int dir);
+
+/*** clipboard ***/
+
+void editorClipboardTouch(struct editorBuffer *B, int y);
+void editorClipboardClear(struct editorConfig *E);
+int editorClipboardPaste(struct editorConfig *E);
+
+/*** macro ***/
+
+void editorMacroStart(struct editorConfig *E);
+int editorMacroStop(struct editorConfig *E);
+void editorMacroRecord(struct editorConfig *E, int key);
+int editorMacroNext(struct editorConfig *E);
+void editorMacroFree(struct editorConfig *E);
+
+/*** buffer ***/
+
+void editorInit(struct editorConfig *E, int screenrows, int screencols);
+void editorFree(struct editorConfig *E);
+struct editorBuffer *editorBufferNew(struct editorConfig *E);
+void editorBufferSwitch(struct editorConfig *E, int idx);
+void editorBufferClose(struct editorConfig *E, int idx);
+void editorBufferEvict(struct editorBuffer *B);
+void editorEvictIdleBuffers(struct editorConfig *E);
+int editorAnyDirty(struct editorConfig *E);
+void editorSetFilename(struct editorBuffer *B, const char *filename);
+char *editorRowsToString(struct editorBuffer *B, size_t *buflen);
+int editorWriteAll(int fd, const char *s, size_t len);
+long long editorStreamRows(struct editorBuffer *B, int (*out)(void *ctx, const char *s, size_t len), void *ctx);
+long long editorWriteRows(struct editorBuffer *B, int fd);
+int editorOpen(struct editorBuffer *B, char *filename);
+void editorOpenFinish(struct editorBuffer *B);
+int editorSave(struct editorConfig *E);
+int editorPoll(struct editorConfig *E);
+int editorLoading(struct editorConfig *E);
+int editorIdle(struct editorConfig *E);
+void editorCompact(struct editorConfig *E);
+
+/*** index ***/
+
+struct editorIndex;
+
+struct editorIndex *editorIndexNew(struct editorSyntax *syntax, const char *data, size_t size, int base,
+                                   int lazy, const int *cancel);
+int editorIndexRows(struct editorIndex *X);
+void editorIndexFree(struct editorIndex *X);
+void editorIndexAdopt(struct editorBuffer *B, struct editorIndex *X);
+int editorIndexFile(struct editorBuffer *B, int fd);
+
+/*** line index ***/
+
+void editorLinesChanged(struct editorBuffer *B, int at);
+long long editorLineOffset(struct editorBuffer *B, int y);
+int editorLineAt(struct editorBuffer *B, long long off, int *cx);
+int editorGoto(struct editorConfig *E, const char *where);
+
+/*** brackets ***/
+
+void editorBracketsCount(erow *row);
+void editorBracketsInvalidate(struct editorBuffer *B);
+void editorBracketsChanged(struct editorBuffer *B, int at);
+int editorBracketsFind(struct editorBuffer *B, int y, int rx, int *match_y, int *match_rx);
+void editorBracketsUpdate(struct editorConfig *E);
+
+/*** pager ***/
+
+int editorPagerOpen(struct editorBuffer *B, char *filename);
+void editorPagerFree(struct editorBuffer *B);
+erow *editorPagerRow(struct editorBuffer *B, int y);
+long long editorPagerLineOffset(struct editorBuffer *B, int y);
+int editorPagerLineAt(struct editorBuffer *B, long long off);
+int editorPagerFind(struct editorBuffer *B, const char *query, int from, int from_cx, int direction,
+                    int *cx);
+
+/*** compression ***/
+
+int editorCompressionForName(const char *filename);
+struct editorReader *editorReaderOpen(FILE *fp);
+void editorReaderClose(struct editorReader *R);
+int editorReaderCompression(struct editorReader *R);
+long long editorReaderOffset(struct editorReader *R);
+int editorReaderError(struct editorReader *R);
+ssize_t editorReaderLine(struct editorReader *R, char **line);
+int editorSaveAsync(struct editorBuffer *B);
+int editorSaverPoll(struct editorConfig *E, struct editorBuffer *B);
+void editorSaverWait(struct editorBuffer *B);
+int editorSaverFinish(struct editorConfig *E, struct editorBuffer *B);
+
+/*** loader ***/
+
+int editorOpenAsync(struct editorBuffer *B, char *filename);
+int editorLoaderPoll(struct editorBuffer *B);
+int editorLoaderProgress(struct editorBuffer *B);
+void editorLoaderCancel(struct editorBuffer *B);
+
+/*** pipe ***/
+
+void editorPipeOpen(struct editorBuffer *B, int fd);
+int editorPipePoll(struct editorBuffer *B);
+void editorPipeFinish(struct editorBuffer *B);
+void editorPipeCancel(struct editorBuffer *B);
+
+/*** journal ***/
+
+void editorJournalInit(struct editorJournal *J);
+void editorJournalFlush(struct editorJournal *J);
+void editorJournalDiscard(struct editorJournal *J);
+void editorJournalFree(struct editorJournal *J);
+void editorJournalSetFilename(struct editorJournal *J, const char *filename);
+void editorJournalInsertRow(struct editorBuffer *B, int at, const char *s, size_t len);
+void editorJournalInsertRows(struct editorBuffer *B, int at, erow *rows, int n);
+void editorJournalDelRow(struct editorBuffer *B, int at);
+void editorJournalDelRows(struct editorBuffer *B, int at, int n);
+void editorJournalInsertChar(struct editorBuffer *B, int row, int at, int c);
+void editorJournalInsert(struct editorBuffer *B, int row, int at, const char *s, size_t len);
+void editorJournalAppend(struct editorBuffer *B, int row, const char *s, size_t len);
+void editorJournalDelChar(struct editorBuffer *B, int row, int at);
+void editorJournalDelChars(struct editorBuffer *B, int row, int at, int len);
+void editorJournalTruncate(struct editorBuffer *B, int row, int size);
+void editorJournalIndent(struct editorBuffer *B, int at, int n, int dir);
+void editorJournalReplace(struct editorBuffer *B, const char *pattern, const char *with, int regex);
+int editorJournalReplay(struct editorBuffer *B);
+
+/*** watch ***/
+
+void editorWatchInit(struct editorConfig *E);
+void editorWatchFree(struct editorConfig *E);
+void editorWatchRemove(struct editorConfig *E, struct editorBuffer *B);
+void editorDiskRecord(struct editorBuffer *B);
+int editorDiskChanged(struct editorBuffer *B);
+int editorWatchPoll(struct editorConfig *E);
+int editorFollow(struct editorConfig *E, int on);
+
+/*** windows ***/
+
+void editorWindowsInit(struct editorConfig *E);
+void editorWindowsFree(struct editorConfig *E);
+void editorWindowStore(struct editorWindow *W);
+void editorWindowLoad(struct editorWindow *W);
+int editorWindowSplit(struct editorConfig *E, char split);
+void editorWindowClose(struct editorConfig *E);
+void editorWindowFocus(struct editorConfig *E, struct editorWindow *W);
+void editorWindowNext(struct editorConfig *E);
+int editorBufferVisible(struct editorConfig *E, struct editorBuffer *B);
+void editorWindowsReplaceBuffer(struct editorConfig *E, struct editorBuffer *from, struct editorBuffer *to);
+void editorWindowsLayout(struct editorConfig *E);
+int editorWindowsCollect(struct editorLayout *node, struct editorWindow **out, int n);
+void editorWindowsShiftRows(struct editorConfig *E, struct editorBuffer *B, int at, int removed,
+                            int inserted);
+void editorWindowsFollow(struct editorConfig *E, struct editorBuffer *B, int oldrows);
+
+/*** find ***/
+
+void editorFindCallback(struct editorConfig *E, char *query, int key);
+
+/*** replace ***/
+
+int editorReplaceAll(struct editorBuffer *B, const char *pattern, const char *with, int regex, char *err,
+                     size_t errlen);
+
+/*** output ***/
+
+void editorScroll(struct editorWindow *W);
+void editorDrawRows(struct editorConfig *E, struct editorWindow *W, struct abuf *ab);
+void editorDrawWindowStatus(struct editorConfig *E, struct editorWindow *W, struct abuf *ab);
+void editorDrawStatusBar(struct editorConfig *E, struct abuf *ab);
+void editorDrawMessageBar(struct editorConfig *E, struct abuf *ab);
+void editorRenderScreen(struct editorConfig *E, struct abuf *ab);
+void editorSetStatusMessage(struct editorConfig *E, const char *fmt, ...);
+
+#endif
@@ -0,0 +1,263 @@
+/*** includes ***/
+
+// Feature test macros (portability): https://www.gnu.org/software/libc/manual/html_node/Feature-Test-Macros.html
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "editor.h"
+
+/*** highlighter ***/
+
+// Re-highlighting every row when a buffer's filetype changes, e.g. on "Save as" under another
+// extension. The rows around the top of the view are highlighted at once so the screen is right
+// straight away. Their comment state is guessed by starting a little above them as if in code.
+// Then the whole buffer is highlighted in the background, one chunk of rows per core, into arrays
+// private to each thread. As in `editorIndexFile()`, each chunk is done as if it started outside
+// a multi-line comment, and again from inside one until the two agree. Once every thread is
+// done, `editorPoll()` picks each chunk's result by the real state at its start and swaps the
+// spans in. Rows must not change meanwhile, so edits first wait for the threads.
+
+#define HIGHLIGHTER_MIN_ROWS 20000  // Fewer rows are highlighted at once
+#define HIGHLIGHTER_CHUNK 10000     // Fewest rows worth a thread
+#define HIGHLIGHTER_MAX_THREADS 64
+#define HIGHLIGHTER_SYNC 256     // Rows above the view highlighted to settle its comment state
+#define HIGHLIGHTER_VISIBLE 256  // Rows from the top of the view highlighted at once
+
+struct editorHighlighterRow {
+  struct editorSpan *hl;
+  int nhl;
+  struct editorBracketSum brackets;
+  int open_comment;
+};
+
+struct editorHighlighterChunk {
+  struct editorHighlighter *H;
+  int first;  // First row of the chunk
+  int nrows;
+  struct editorPool pool;  // Holds the chunk's spans until they are swapped in
+  pthread_t thread;
+  int threaded;
+
+  struct editorHighlighterRow *rows;  // Each row highlighted as if the chunk starts outside a comment
+  struct editorHighlighterRow *alt;   // ...and from inside one, for the first `nalt` rows
+  int nalt;
+};
+
+struct editorHighlighter {
+  struct editorBuffer *B;
+  struct editorSyntax *syntax;
+  int nchunks;
+  struct editorHighlighterChunk chunks[HIGHLIGHTER_MAX_THREADS];
+  int pending;  // Chunks still being highlighted
+  int cancel;
+};
+
+// Highlights a copy of `src`, so the buffer's own row is left alone. A row of an evicted buffer
+// is rendered for the purpose and keeps no spans, as evicted rows hold none.
+static int editorHighlighterRow(struct editorHighlighterChunk *C, erow *src, int in_comment,
+                                struct editorHighlighterRow *out) {
+  erow row = *src;
+  row.hl = NULL;
+
+  int evicted = (row.render == NULL);
+  if (evicted) {
+    row.shared = 0;
+    editorRenderRow(&C->pool, &row);
+  }
+  in_comment = editorHighlightRow(&C->pool, C->H->syntax, &row, in_comment);
+  if (evicted) {
+    if (!row.shared) poolFree(&C->pool, row.render);
+    poolFree(&C->pool, row.hl);
+    row.hl = NULL;
+    row.nhl = 0;
+  }
+
+  out->hl = row.hl;
+  out->nhl = row.nhl;
+  out->brackets = row.brackets;
+  out->open_comment = in_comment;
+  return in_comment;
+}
+
+static void *editorHighlighterWork(void *arg) {
+  struct editorHighlighterChunk *C = arg;
+  struct editorHighlighter *H = C->H;
+  erow *rows = &H->B->row[C->first];
+  int in_comment = 0;
+
+  for (int k = 0; k < C->nrows; k++) {
+    if (k % 1024 == 0 && __atomic_load_n(&H->cancel, __ATOMIC_RELAXED)) break;
+    in_comment = editorHighlighterRow(C, &rows[k], in_comment, &C->rows[k]);
+  }
+
+  // Speculate that the chunk starts inside a comment, until that stops making a difference
+  if (C->first > 0 && H->syntax->multiline_comment_start) {
+    in_comment = 1;
+    for (int k = 0; k < C->nrows; k++) {
+      if (k % 1024 == 0 && __atomic_load_n(&H->cancel, __ATOMIC_RELAXED)) break;
+      in_comment = editorHighlighterRow(C, &rows[k], in_comment, &C->alt[k]);
+      C->nalt++;
+      if (in_comment == C->rows[k].open_comment) break;  // Converged: the rest is the same either way
+    }
+  }
+
+  __atomic_sub_fetch(&H->pending, 1, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+// Joins the threads. Their spans move to the buffer's pool, to be swapped in or freed.
+static void editorHighlighterJoin(struct editorHighlighter *H) {
+  for (int c = 0; c < H->nchunks; c++) {
+    struct editorHighlighterChunk *C = &H->chunks[c];
+    if (C->threaded) pthread_join(C->thread, NULL);
+    poolMerge(H->B->pool, &C->pool);
+  }
+}
+
+static void editorHighlighterFree(struct editorBuffer *B) {
+  struct editorHighlighter *H = B->highlighter;
+
+  for (int c = 0; c < H->nchunks; c++) {
+    struct editorHighlighterChunk *C = &H->chunks[c];
+    free(C->rows);
+    free(C->alt);
+  }
+  free(H);
+  B->highlighter = NULL;
+}
+
+// Stops a re-highlight in progress, discarding what it did
+void editorHighlighterCancel(struct editorBuffer *B) {
+  struct editorHighlighter *H = B->highlighter;
+  if (H == NULL) return;
+
+  __atomic_store_n(&H->cancel, 1, __ATOMIC_RELAXED);
+  editorHighlighterJoin(H);
+  for (int c = 0; c < H->nchunks; c++) {
+    struct editorHighlighterChunk *C = &H->chunks[c];
+    for (int k = 0; k < C->nrows; k++) poolFree(B->pool, C->rows[k].hl);
+    for (int k = 0; k < C->nalt; k++) poolFree(B->pool, C->alt[k].hl);
+  }
+  editorHighlighterFree(B);
+}
+
+// Waits for a re-highlight in progress and swaps its spans into the rows
+void editorHighlighterFinish(struct editorBuffer *B) {
+  struct editorHighlighter *H = B->highlighter;
+  if (H == NULL) return;
+
+  TRACE_BEGIN("editorHighlighterFinish");
+  editorHighlighterJoin(H);
+
+  // The real state at each chunk's start picks one of its two highlightings
+  int in_comment = 0;
+  for (int c = 0; c < H->nchunks; c++) {
+    struct editorHighlighterChunk *C = &H->chunks[c];
+    int alt = in_comment;
+
+    for (int k = 0; k < C->nrows; k++) {
+      erow *row = &B->row[C->first + k];
+      struct editorHighlighterRow *use = &C->rows[k], *drop = k < C->nalt ? &C->alt[k] : NULL;
+      if (alt && drop) {
+        use = drop;
+        drop = &C->rows[k];
+      }
+      if (drop) poolFree(B->pool, drop->hl);
+
+      poolFree(B->pool, row->hl);
+      row->hl = use->hl;
+      row->nhl = use->nhl;
+      row->brackets = use->brackets;
+      row->hl_open_comment = use->open_comment;
+    }
+    if (C->nrows) in_comment = B->row[C->first + C->nrows - 1].hl_open_comment;
+  }
+
+  editorHighlighterFree(B);
+  editorBracketsInvalidate(B);
+  B->version++;
+  TRACE_END("editorHighlighterFinish");
+}
+
+// Swaps in a finished re-highlight. Returns non-zero if it did.
+int editorHighlighterPoll(struct editorBuffer *B) {
+  struct editorHighlighter *H = B->highlighter;
+  if (H == NULL || __atomic_load_n(&H->pending, __ATOMIC_ACQUIRE) > 0) return 0;
+
+  editorHighlighterFinish(B);
+  return 1;
+}
+
+// Highlights every row of `B` again, for a new `B->syntax`
+void editorHighlighterStart(struct editorBuffer *B) {
+  editorHighlighterCancel(B);
+
+  // No filetype: rows highlighted for a previous one lose their colours
+  if (B->syntax == NULL) {
+    for (int filerow = 0; filerow < B->numrows; filerow++) {
+      editorHighlightRow(B->pool, NULL, &B->row[filerow], 0);
+      B->row[filerow].hl_open_comment = 0;
+    }
+    editorBracketsInvalidate(B);
+    B->version++;
+    return;
+  }
+
+  // Small buffers are done here and now, as are rows still arriving from the loader
+  if (B->loader || B->numrows < HIGHLIGHTER_MIN_ROWS) {
+    for (int filerow = 0; filerow < B->numrows; filerow++) {
+      editorUpdateSyntax(B, &B->row[filerow]);
+    }
+    return;
+  }
+  TRACE_BEGIN("editorHighlighterStart");
+
+  // What is on screen first, starting from a guess
+  int top = B->rowoff - HIGHLIGHTER_SYNC;
+  if (top < 0) top = 0;
+  int in_comment = 0;
+  for (int y = top; y < B->numrows && y < B->rowoff + HIGHLIGHTER_VISIBLE; y++) {
+    erow *row = &B->row[y];
+    if (row->render == NULL) editorRenderRow(B->pool, row);
+    in_comment = editorHighlightRow(B->pool, B->syntax, row, in_comment);
+    row->hl_open_comment = in_comment;
+  }
+  editorBracketsInvalidate(B);
+  B->version++;
+
+  struct editorHighlighter *H = calloc(1, sizeof(struct editorHighlighter));
+  H->B = B;
+  H->syntax = B->syntax;
+
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  if (n > B->numrows / HIGHLIGHTER_CHUNK) n = B->numrows / HIGHLIGHTER_CHUNK;
+  if (n > HIGHLIGHTER_MAX_THREADS) n = HIGHLIGHTER_MAX_THREADS;
+  if (n < 1) n = 1;
+  H->nchunks = n;
+  H->pending = n;
+  B->highlighter = H;
+
+  for (int c = 0; c < n; c++) {
+    struct editorHighlighterChunk *C = &H->chunks[c];
+    C->H = H;
+    C->first = (long)B->numrows * c / n;
+    C->nrows = (long)B->numrows * (c + 1) / n - C->first;
+    poolInit(&C->pool, 0);
+
+    C->rows = calloc(C->nrows, sizeof(struct editorHighlighterRow));  // Cancelling frees every entry
+    C->alt = malloc(sizeof(struct editorHighlighterRow) * C->nrows);
+  }
+
+  for (int c = 0; c < n; c++) {
+    struct editorHighlighterChunk *C = &H->chunks[c];
+    C->threaded = pthread_create(&C->thread, NULL, editorHighlighterWork, C) == 0;
+    if (!C->threaded) editorHighlighterWork(C);
+  }
+  TRACE_END("editorHighlighterStart");
+}
@@ -0,0 +1,322 @@
+/*** includes ***/
+
+// Feature test macros (portability): https://www.gnu.org/software/libc/manual/html_node/Feature-Test-Macros.html
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "editor.h"
+
+/*** index ***/
+
+// Parallel open. The file is mapped and cut into one chunk of whole lines per core. A first
+// pass counts each chunk's lines with `memchr()`, which fixes where its rows go; a second builds
+// and highlights them. Each chunk is highlighted as if it started outside a multi-line comment,
+// and again from inside one until the two agree on a row's end state (usually within a line or
+// two); a serial pass over the chunks then keeps whichever matches the real state. The rows are
+// built apart from any buffer, so the loader thread can index a file a slice at a time while the
+// main thread adopts the slices already built.
+
+#define INDEX_MIN_CHUNK (256 * 1024)  // Bytes; smaller files are not worth a thread
+#define INDEX_MAX_THREADS 64
+#define INDEX_CHECK_ROWS 4096         // Rows between looks at `cancel`
+
+struct editorIndexChunk {
+  struct editorIndex *X;
+  const char *start, *end;  // Whole lines of the mapped file
+  int first;                // Index of the chunk's first row in `X->rows`
+  int nrows;
+  int built;                // Rows built; fewer than `nrows` if the index was cancelled
+  struct editorPool pool;   // Private to the chunk's thread until it is merged into the buffer's
+
+  int open_comment;      // End state when the chunk starts outside a comment
+  int alt_open_comment;  // End state when it starts inside one
+  struct editorSpan **alt_hl;  // Highlighting from inside a comment, for the first `nalt` rows
+  int *alt_nhl;
+  struct editorBracketSum *alt_brackets;
+  int *alt_open;
+  int nalt;
+};
+
+struct editorIndex {
+  struct editorSyntax *syntax;
+  int lazy;              // Rows are left unrendered, as an evicted buffer's are
+  const int *cancel;     // Set by another thread to stop building
+  erow *rows;
+  int base;              // Row index the first row will have in the buffer
+  int numrows;
+  int n;
+  struct editorIndexChunk chunks[INDEX_MAX_THREADS];
+};
+
+static void *editorIndexCount(void *arg) {
+  struct editorIndexChunk *C = arg;
+  const char *p = C->start;
+
+  while (p < C->end) {
+    const char *nl = memchr(p, '\n', C->end - p);
+    C->nrows++;
+    if (nl == NULL) break;
+    p = nl + 1;
+  }
+  return NULL;
+}
+
+static void *editorIndexBuild(void *arg) {
+  struct editorIndexChunk *C = arg;
+  struct editorIndex *X = C->X;
+  struct editorSyntax *syntax = X->syntax;
+  erow *rows = &X->rows[C->first];
+  const char *p = C->start;
+  int in_comment = 0;
+
+  for (int k = 0; k < C->nrows; k++) {
+    if (k % INDEX_CHECK_ROWS == 0 && k > 0 && X->cancel && __atomic_load_n(X->cancel, __ATOMIC_RELAXED))
+      return NULL;
+
+    const char *nl = memchr(p, '\n', C->end - p);
+    const char *eol = nl ? nl : C->end;
+    size_t len = eol - p;
+    while (len > 0 && p[len - 1] == '\r') len--;
+
+    erow *row = &rows[k];
+    row->idx = X->base + C->first + k;
+    row->size = len;
+    row->chars = poolAlloc(&C->pool, len + 1);
+    memcpy(row->chars, p, len);
+    row->chars[len] = '\0';
+
+    row->render = NULL;
+    row->shared = 0;
+    row->hl = NULL;
+    if (X->lazy) {
+      row->rsize = 0;
+      row->nhl = 0;
+      row->hl_open_comment = 0;
+      memset(&row->brackets, 0, sizeof(row->brackets));
+    } else {
+      editorRenderRow(&C->pool, row);
+      in_comment = editorHighlightRow(&C->pool, syntax, row, in_comment);
+      row->hl_open_comment = in_comment;
+    }
+    C->built++;
+
+    p = eol + 1;
+  }
+  C->open_comment = in_comment;
+  C->alt_open_comment = in_comment;
+
+  if (X->lazy || syntax == NULL || syntax->multiline_comment_start == NULL) return NULL;
+
+  // Speculate that the chunk starts inside a comment, until that stops making a difference
+  C->alt_hl = malloc(sizeof(struct editorSpan *) * (C->nrows ? C->nrows : 1));
+  C->alt_nhl = malloc(sizeof(int) * (C->nrows ? C->nrows : 1));
+  C->alt_brackets = malloc(sizeof(struct editorBracketSum) * (C->nrows ? C->nrows : 1));
+  C->alt_open = malloc(sizeof(int) * (C->nrows ? C->nrows : 1));
+  in_comment = 1;
+
+  int k;
+  for (k = 0; k < C->nrows; k++) {
+    erow alt = rows[k];
+    alt.hl = NULL;
+    in_comment = editorHighlightRow(&C->pool, syntax, &alt, in_comment);
+
+    C->alt_hl[C->nalt] = alt.hl;
+    C->alt_nhl[C->nalt] = alt.nhl;
+    C->alt_brackets[C->nalt] = alt.brackets;
+    C->alt_open[C->nalt] = in_comment;
+    C->nalt++;
+    if (in_comment == rows[k].hl_open_comment) break;  // Converged
+  }
+  if (k == C->nrows) C->alt_open_comment = in_comment;
+  return NULL;
+}
+
+// Runs `fn` on every chunk, one thread each, with the first on the calling thread
+static void editorIndexRun(struct editorIndexChunk *chunks, int n, void *(*fn)(void *)) {
+  pthread_t threads[INDEX_MAX_THREADS];
+  int spawned[INDEX_MAX_THREADS];
+
+  for (int c = 1; c < n; c++) {
+    spawned[c] = pthread_create(&threads[c], NULL, fn, &chunks[c]) == 0;
+    if (!spawned[c]) fn(&chunks[c]);
+  }
+  fn(&chunks[0]);
+  for (int c = 1; c < n; c++) {
+    if (spawned[c]) pthread_join(threads[c], NULL);
+  }
+}
+
+// Builds the rows of the `size` bytes of whole lines at `data`, highlighted with `syntax`, to
+// follow row `base - 1` of a buffer. `lazy` rows are neither rendered nor highlighted, like those
+// of an evicted buffer, until something reads them. Safe to call off the main thread: nothing is
+// shared until `editorIndexAdopt()`. Returns NULL if `*cancel` was set while it ran.
+struct editorIndex *editorIndexNew(struct editorSyntax *syntax, const char *data, size_t size, int base,
+                                   int lazy, const int *cancel) {
+  TRACE_BEGIN("editorIndexNew");
+  struct editorIndex *X = calloc(1, sizeof(struct editorIndex));
+  X->syntax = syntax;
+  X->lazy = lazy;
+  X->cancel = cancel;
+  X->base = base;
+
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  long n = size / INDEX_MIN_CHUNK;
+  if (n > cores) n = cores;
+  if (n > INDEX_MAX_THREADS) n = INDEX_MAX_THREADS;
+  if (n < 1) n = 1;
+  X->n = n;
+
+  // Chunk boundaries fall just after a newline, so every chunk holds whole lines
+  const char *end = data + size;
+  const char *p = data;
+  for (int c = 0; c < n; c++) {
+    struct editorIndexChunk *C = &X->chunks[c];
+    C->X = X;
+    C->start = p;
+
+    const char *q = data + size / n * (c + 1);
+    if (q < p) q = p;
+    if (c == n - 1) q = end;
+    const char *nl = q < end ? memchr(q, '\n', end - q) : NULL;
+    p = nl ? nl + 1 : end;
+
+    C->end = p;
+    poolInit(&C->pool, 0);
+  }
+
+  editorIndexRun(X->chunks, n, editorIndexCount);
+
+  for (int c = 0; c < n; c++) {
+    X->chunks[c].first = X->numrows;
+    X->numrows += X->chunks[c].nrows;
+  }
+  X->rows = malloc(sizeof(erow) * (X->numrows ? X->numrows : 1));
+#ifdef MADV_POPULATE_WRITE
+  // Every row is about to be written: one call faults the array in far faster than its pages
+  // fault one by one. Only whole pages, as `malloc()` memory need not start on one.
+  size_t page = sysconf(_SC_PAGESIZE);
+  uintptr_t first = ((uintptr_t)X->rows + page - 1) & ~(uintptr_t)(page - 1);
+  uintptr_t last = ((uintptr_t)X->rows + sizeof(erow) * X->numrows) & ~(uintptr_t)(page - 1);
+  if (last > first) madvise((void *)first, last - first, MADV_POPULATE_WRITE);
+#endif
+
+  editorIndexRun(X->chunks, n, editorIndexBuild);
+  TRACE_END("editorIndexNew");
+
+  if (cancel && __atomic_load_n(cancel, __ATOMIC_RELAXED)) {
+    editorIndexFree(X);
+    return NULL;
+  }
+  return X;
+}
+
+// Number of rows `X` holds
+int editorIndexRows(struct editorIndex *X) {
+  return X->numrows;
+}
+
+// Frees an index that will not be adopted, with all of its rows
+void editorIndexFree(struct editorIndex *X) {
+  for (int c = 0; c < X->n; c++) {
+    struct editorIndexChunk *C = &X->chunks[c];
+    for (int k = 0; k < C->built; k++) {
+      erow *row = &X->rows[C->first + k];
+      if (!row->shared) poolFree(&C->pool, row->render);
+      poolFree(&C->pool, row->chars);
+      poolFree(&C->pool, row->hl);
+    }
+    for (int k = 0; k < C->nalt; k++) poolFree(&C->pool, C->alt_hl[k]);
+    poolTrim(&C->pool);
+
+    free(C->alt_hl);
+    free(C->alt_nhl);
+    free(C->alt_brackets);
+    free(C->alt_open);
+  }
+  free(X->rows);
+  free(X);
+}
+
+// Appends the rows of `X` to `B` and frees `X`. The row they follow decides which of each
+// chunk's two highlightings is kept.
+void editorIndexAdopt(struct editorBuffer *B, struct editorIndex *X) {
+  TRACE_BEGIN("editorIndexAdopt");
+  editorHighlighterFinish(B);
+  editorClipboardTouch(B, B->numrows);
+
+  // Stitch: the real state at each chunk boundary picks one of its two highlightings
+  int in_comment = B->numrows > 0 && B->row[B->numrows - 1].hl_open_comment;
+  for (int c = 0; c < X->n; c++) {
+    struct editorIndexChunk *C = &X->chunks[c];
+    poolMerge(B->pool, &C->pool);
+
+    for (int k = 0; k < C->nalt; k++) {
+      erow *row = &X->rows[C->first + k];
+      if (in_comment) {
+        poolFree(B->pool, row->hl);
+        row->hl = C->alt_hl[k];
+        row->nhl = C->alt_nhl[k];
+        row->brackets = C->alt_brackets[k];
+        row->hl_open_comment = C->alt_open[k];
+      } else {
+        poolFree(B->pool, C->alt_hl[k]);
+      }
+    }
+    in_comment = in_comment ? C->alt_open_comment : C->open_comment;
+
+    free(C->alt_hl);
+    free(C->alt_nhl);
+    free(C->alt_brackets);
+    free(C->alt_open);
+  }
+
+  int at = B->numrows;
+  if (B->numrows == 0) {
+    free(B->row);
+    B->row = X->rows;  // An empty buffer takes the index's rows as they are
+    B->rowcap = X->numrows;
+    X->rows = NULL;
+  } else {
+    editorRowsReserve(B, B->numrows + X->numrows);
+    memcpy(&B->row[at], X->rows, sizeof(erow) * X->numrows);
+  }
+  if (X->base != at) {
+    for (int k = 0; k < X->numrows; k++) B->row[at + k].idx = at + k;
+  }
+  B->numrows += X->numrows;
+
+  editorBracketsInvalidate(B);
+  editorLinesChanged(B, at);
+  B->version++;
+  free(X->rows);
+  free(X);
+  TRACE_END("editorIndexAdopt");
+}
+
+// Loads the regular file open on `fd` into the empty buffer `B`. A plain buffer's rows are
+// loaded as if evicted, since nothing may ever draw them. Returns -1, having done nothing, if the
+// file can't be mapped; the caller should read it line by line instead.
+int editorIndexFile(struct editorBuffer *B, int fd) {
+  struct stat st;
+  if (B->numrows != 0 || fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) return -1;
+  if (st.st_size == 0) return 0;
+
+  const char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED) return -1;
+  madvise((void *)data, st.st_size, MADV_SEQUENTIAL);
+
+  struct editorIndex *X = editorIndexNew(B->syntax, data, st.st_size, 0, B->plain, NULL);
+  munmap((void *)data, st.st_size);
+  editorIndexAdopt(B, X);
+  if (B->plain) B->evicted = 1;
+  return 0;
+}
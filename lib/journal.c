@@ -0,0 +1,403 @@
+/*** includes ***/
+
+// Feature test macros (portability): https://www.gnu.org/software/libc/manual/html_node/Feature-Test-Macros.html
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "editor.h"
+
+#ifdef __APPLE__
+#define st_mtim st_mtimespec
+#endif
+
+/*** journal ***/
+
+// Crash recovery. Every primitive row edit is appended to `.<filename>.journal` as a compact
+// record: an opcode byte followed by LEB128 varints (and raw bytes for inserted text). Records
+// are batched in memory and written with one `fdatasync()` when the editor goes idle, so the
+// cost is proportional to the size of the edits, not the buffer. The header pins the size and
+// mtime (to the nanosecond) of the file the edits apply to; saving the buffer deletes the journal.
+
+#define JOURNAL_MAGIC "EDJ2"
+#define JOURNAL_HEADER_SIZE 28          // Magic, then 64-bit file size, mtime and its nanoseconds
+#define JOURNAL_FLUSH_BYTES (64 * 1024)  // Flush early when this much is pending
+
+enum journalOp {
+  J_INSERT_ROW = 1,  // at, len, bytes
+  J_DEL_ROW,         // at
+  J_INSERT_CHAR,     // row, at, c
+  J_APPEND,          // row, len, bytes
+  J_DEL_CHAR,        // row, at
+  J_TRUNCATE,        // row, size
+  J_INSERT_ROWS,     // at, n, then each row's len and bytes
+  J_DEL_ROWS,        // at, n
+  J_INSERT,          // row, at, len, bytes
+  J_DEL_CHARS,       // row, at, len
+  J_INDENT,          // at, n
+  J_UNINDENT,        // at, n
+  J_REPLACE,         // regex, len, pattern, len, replacement: replaced everywhere
+};
+
+static void journalPutVarint(struct abuf *ab, uint64_t v) {
+  char buf[10];
+  int len = 0;
+
+  do {
+    buf[len] = v & 0x7f;
+    v >>= 7;
+    if (v) buf[len] |= 0x80;
+    len++;
+  } while (v);
+
+  abAppend(ab, buf, len);
+}
+
+static int journalGetVarint(const unsigned char **p, const unsigned char *end, uint64_t *v) {
+  *v = 0;
+  for (int shift = 0; *p < end && shift < 64; shift += 7) {
+    unsigned char byte = *(*p)++;
+    *v |= (uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) return 0;
+  }
+  return -1;  // Truncated record: the process died while it was being written
+}
+
+static void journalPutInt64(unsigned char *p, int64_t v) {
+  for (int j = 0; j < 8; j++) p[j] = (uint64_t)v >> (8 * j);
+}
+
+// `.<name>.journal` next to the file
+static char *journalPath(const char *filename) {
+  const char *slash = strrchr(filename, '/');
+  int dirlen = slash ? slash - filename + 1 : 0;
+  char *path = malloc(strlen(filename) + 10);
+
+  memcpy(path, filename, dirlen);
+  strcpy(&path[dirlen], ".");
+  strcat(path, &filename[dirlen]);
+  strcat(path, ".journal");
+  return path;
+}
+
+static void journalHeader(const char *filename, unsigned char *header) {
+  struct stat st;
+  int64_t size = -1, mtime = -1, mtime_nsec = -1;
+
+  // A same-size rewrite within the same second must not pass for the file the edits were made on
+  if (stat(filename, &st) == 0) {
+    size = st.st_size;
+    mtime = st.st_mtim.tv_sec;
+    mtime_nsec = st.st_mtim.tv_nsec;
+  }
+
+  memcpy(header, JOURNAL_MAGIC, 4);
+  journalPutInt64(&header[4], size);
+  journalPutInt64(&header[12], mtime);
+  journalPutInt64(&header[20], mtime_nsec);
+}
+
+void editorJournalInit(struct editorJournal *J) {
+  J->fd = -1;
+  J->path = NULL;
+  J->pending.b = NULL;
+  J->pending.len = 0;
+  J->suspended = 0;
+}
+
+// Writes out pending records and makes them durable
+void editorJournalFlush(struct editorJournal *J) {
+  if (J->fd == -1 || J->pending.len == 0) return;
+  TRACE_BEGIN("editorJournalFlush");
+
+  if (write(J->fd, J->pending.b, J->pending.len) == J->pending.len) {
+#ifdef __APPLE__
+    fsync(J->fd);
+#else
+    fdatasync(J->fd);
+#endif
+  }
+
+  abFree(&J->pending);
+  J->pending.b = NULL;
+  J->pending.len = 0;
+  TRACE_END("editorJournalFlush");
+}
+
+// Drops the journal, e.g. once the buffer has been saved or its changes discarded
+void editorJournalDiscard(struct editorJournal *J) {
+  if (J->fd != -1) {
+    close(J->fd);
+    J->fd = -1;
+  }
+  if (J->path && !J->suspended) unlink(J->path);
+
+  abFree(&J->pending);
+  J->pending.b = NULL;
+  J->pending.len = 0;
+}
+
+void editorJournalFree(struct editorJournal *J) {
+  editorJournalDiscard(J);
+  free(J->path);
+  J->path = NULL;
+}
+
+void editorJournalSetFilename(struct editorJournal *J, const char *filename) {
+  editorJournalFree(J);
+  if (filename) J->path = journalPath(filename);
+}
+
+// Starts a record with its opcode and first operands. Returns where the rest of it goes, or NULL
+// if edits are not being recorded.
+static struct abuf *journalBegin(struct editorBuffer *B, int op, uint64_t a, uint64_t b) {
+  struct editorJournal *J = &B->journal;
+  if (J->suspended || J->path == NULL) return NULL;
+
+  // The first edit after a load or save starts a new journal against the file on disk
+  if (J->fd == -1) {
+    J->fd = open(J->path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (J->fd == -1) return NULL;
+
+    unsigned char header[JOURNAL_HEADER_SIZE];
+    journalHeader(B->filename, header);
+    abAppend(&J->pending, (char *)header, sizeof(header));
+  }
+
+  char opcode = op;
+  abAppend(&J->pending, &opcode, 1);
+  journalPutVarint(&J->pending, a);
+  if (op != J_DEL_ROW) journalPutVarint(&J->pending, b);
+  return &J->pending;
+}
+
+static void journalEnd(struct editorBuffer *B) {
+  if (B->journal.pending.len >= JOURNAL_FLUSH_BYTES) editorJournalFlush(&B->journal);
+}
+
+static void editorJournalRecord(struct editorBuffer *B, int op, uint64_t a, uint64_t b,
+                                const char *s, size_t len) {
+  struct abuf *ab = journalBegin(B, op, a, b);
+  if (ab == NULL) return;
+
+  if (s) abAppend(ab, s, len);
+  journalEnd(B);
+}
+
+void editorJournalInsertRow(struct editorBuffer *B, int at, const char *s, size_t len) {
+  editorJournalRecord(B, J_INSERT_ROW, at, len, s, len);
+}
+
+void editorJournalInsertRows(struct editorBuffer *B, int at, erow *rows, int n) {
+  struct abuf *ab = journalBegin(B, J_INSERT_ROWS, at, n);
+  if (ab == NULL) return;
+
+  for (int k = 0; k < n; k++) {
+    journalPutVarint(ab, rows[k].size);
+    abAppend(ab, rows[k].chars, rows[k].size);
+  }
+  journalEnd(B);
+}
+
+void editorJournalDelRow(struct editorBuffer *B, int at) {
+  editorJournalRecord(B, J_DEL_ROW, at, 0, NULL, 0);
+}
+
+void editorJournalDelRows(struct editorBuffer *B, int at, int n) {
+  editorJournalRecord(B, J_DEL_ROWS, at, n, NULL, 0);
+}
+
+void editorJournalInsertChar(struct editorBuffer *B, int row, int at, int c) {
+  char ch = c;
+  editorJournalRecord(B, J_INSERT_CHAR, row, at, &ch, 1);
+}
+
+void editorJournalInsert(struct editorBuffer *B, int row, int at, const char *s, size_t len) {
+  struct abuf *ab = journalBegin(B, J_INSERT, row, at);
+  if (ab == NULL) return;
+
+  journalPutVarint(ab, len);
+  abAppend(ab, s, len);
+  journalEnd(B);
+}
+
+void editorJournalAppend(struct editorBuffer *B, int row, const char *s, size_t len) {
+  editorJournalRecord(B, J_APPEND, row, len, s, len);
+}
+
+void editorJournalDelChar(struct editorBuffer *B, int row, int at) {
+  editorJournalRecord(B, J_DEL_CHAR, row, at, NULL, 0);
+}
+
+void editorJournalDelChars(struct editorBuffer *B, int row, int at, int len) {
+  struct abuf *ab = journalBegin(B, J_DEL_CHARS, row, at);
+  if (ab == NULL) return;
+
+  journalPutVarint(ab, len);
+  journalEnd(B);
+}
+
+void editorJournalTruncate(struct editorBuffer *B, int row, int size) {
+  editorJournalRecord(B, J_TRUNCATE, row, size, NULL, 0);
+}
+
+void editorJournalIndent(struct editorBuffer *B, int at, int n, int dir) {
+  editorJournalRecord(B, dir > 0 ? J_INDENT : J_UNINDENT, at, n, NULL, 0);
+}
+
+void editorJournalReplace(struct editorBuffer *B, const char *pattern, const char *with, int regex) {
+  size_t patlen = strlen(pattern), withlen = strlen(with);
+  struct abuf *ab = journalBegin(B, J_REPLACE, regex, patlen);
+  if (ab == NULL) return;
+
+  abAppend(ab, pattern, patlen);
+  journalPutVarint(ab, withlen);
+  abAppend(ab, with, withlen);
+  journalEnd(B);
+}
+
+// Replays a journal left behind by a previous session onto the freshly loaded file, in one
+// pass. Returns the number of edits applied, or 0 if there is no journal for this file as it
+// is on disk now.
+int editorJournalReplay(struct editorBuffer *B) {
+  struct editorJournal *J = &B->journal;
+  if (J->path == NULL || J->suspended) return 0;
+
+  int fd = open(J->path, O_RDONLY);
+  if (fd == -1) return 0;
+
+  struct stat st;
+  unsigned char *data = NULL;
+  if (fstat(fd, &st) == 0 && st.st_size >= JOURNAL_HEADER_SIZE) {
+    data = malloc(st.st_size);
+    if (data && read(fd, data, st.st_size) != st.st_size) {
+      free(data);
+      data = NULL;
+    }
+  }
+  close(fd);
+  if (data == NULL) return 0;
+
+  unsigned char header[JOURNAL_HEADER_SIZE];
+  journalHeader(B->filename, header);
+  if (memcmp(data, header, JOURNAL_HEADER_SIZE) != 0) {
+    free(data);  // Written against a different version of the file
+    return 0;
+  }
+
+  const unsigned char *p = data + JOURNAL_HEADER_SIZE;
+  const unsigned char *end = data + st.st_size;
+  const unsigned char *good = p;  // End of the last complete record
+  int edits = 0;
+
+  J->suspended++;
+  while (p < end) {
+    int op = *p++;
+    uint64_t a, b = 0, c = 0;
+
+    if (journalGetVarint(&p, end, &a) == -1) break;
+    if (op != J_DEL_ROW && journalGetVarint(&p, end, &b) == -1) break;
+    if ((op == J_INSERT || op == J_DEL_CHARS) && journalGetVarint(&p, end, &c) == -1) break;
+    if ((op == J_DEL_ROW || op == J_DEL_CHAR || op == J_TRUNCATE || op == J_INSERT_CHAR ||
+         op == J_APPEND || op == J_INSERT || op == J_DEL_CHARS) && a >= (uint64_t)B->numrows) break;
+    if ((op == J_DEL_ROWS || op == J_INDENT || op == J_UNINDENT) && a + b > (uint64_t)B->numrows) break;
+
+    switch (op) {
+      case J_INSERT_ROW:
+        if ((uint64_t)(end - p) < b) goto done;
+        editorInsertRow(B, a, (char *)p, b);
+        p += b;
+        break;
+      case J_DEL_ROW:
+        editorDelRow(B, a);
+        break;
+      case J_INSERT_CHAR:
+        if (p >= end) goto done;
+        editorRowInsertChar(B, &B->row[a], b, *p++);
+        break;
+      case J_APPEND:
+        if ((uint64_t)(end - p) < b) goto done;
+        editorRowAppendString(B, &B->row[a], (char *)p, b);
+        p += b;
+        break;
+      case J_DEL_CHAR:
+        editorRowDelChar(B, &B->row[a], b);
+        break;
+      case J_TRUNCATE:
+        editorRowTruncate(B, &B->row[a], b);
+        break;
+      case J_INSERT_ROWS: {
+        if (a > (uint64_t)B->numrows || b > (uint64_t)(end - p)) goto done;  // Every row takes a byte
+        erow *rows = malloc(sizeof(erow) * (b ? b : 1));
+        uint64_t k;
+        for (k = 0; k < b; k++) {
+          uint64_t len;
+          if (journalGetVarint(&p, end, &len) == -1 || (uint64_t)(end - p) < len) break;
+          rows[k].chars = (char *)p;
+          rows[k].size = len;
+          p += len;
+        }
+        if (k == b) editorInsertRows(B, a, rows, b);
+        free(rows);
+        if (k < b) goto done;
+      } break;
+      case J_DEL_ROWS:
+        editorDelRows(B, a, b, NULL);
+        break;
+      case J_INSERT:
+        if ((uint64_t)(end - p) < c) goto done;
+        editorRowInsertString(B, &B->row[a], b, (char *)p, c);
+        p += c;
+        break;
+      case J_DEL_CHARS:
+        editorRowDelChars(B, &B->row[a], b, c);
+        break;
+      case J_INDENT:
+      case J_UNINDENT:
+        editorIndentRows(B, a, b, op == J_INDENT ? 1 : -1);
+        break;
+      case J_REPLACE: {
+        uint64_t withlen;
+        if ((uint64_t)(end - p) < b) goto done;
+        const unsigned char *pattern = p;
+        p += b;
+        if (journalGetVarint(&p, end, &withlen) == -1 || (uint64_t)(end - p) < withlen) goto done;
+
+        char *pat = strndup((const char *)pattern, b), *with = strndup((const char *)p, withlen);
+        char err[80];
+        editorReplaceAll(B, pat, with, a, err, sizeof(err));
+        free(pat);
+        free(with);
+        p += withlen;
+      } break;
+      default:
+        goto done;  // Corrupt tail
+    }
+    edits++;
+    good = p;
+  }
+done:
+  J->suspended--;
+
+  off_t valid = good - data;
+  free(data);
+
+  // Keep journaling on top of the recovered state: the old journal is the prefix of the new one
+  if (edits > 0) {
+    J->fd = open(J->path, O_WRONLY | O_APPEND);
+    if (J->fd != -1 && ftruncate(J->fd, valid) == -1) {
+      close(J->fd);
+      J->fd = -1;
+    }
+  }
+
+  return edits;
+}
@@ -0,0 +1,530 @@
+/*** includes ***/
+
+// Feature test macros (portability): https://www.gnu.org/software/libc/manual/html_node/Feature-Test-Macros.html
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "editor.h"
+
+#ifdef __APPLE__
+#define st_mtim st_mtimespec
+#endif
+
+/*** lexer ***/
+
+// A syntax is compiled into a DFA so that highlighting costs one table lookup per byte. Each
+// state is a configuration of a character-by-character highlighter: the mode (code, comment or
+// string), whether the previous byte was a separator or part of a number, which keywords the
+// word so far is a prefix of, and how much of a comment delimiter the last bytes spell. The
+// states reachable from the start of a row are found by stepping that highlighter over every
+// byte class. Bytes no keyword or delimiter tells apart share a class, which keeps rows short.
+// A keyword is only known once the byte after it arrives, and a delimiter once its last byte
+// does, so a move can recolour the `back` bytes before it.
+
+#define LEX_EOL 256         // Pseudo-byte for the end of a row
+#define LEX_MAX_WORD 200    // Longest keyword or delimiter
+#define LEX_CACHE_MAGIC "EDX1"
+
+enum lexMode {
+  LEX_CODE = 0,
+  LEX_COMMENT,  // Inside a multi-line comment
+  LEX_LINE,     // Inside a single-line comment, up to the end of the row
+  LEX_STRING,
+  LEX_ESCAPE,   // After a backslash in a string
+};
+
+struct lexConfig {
+  int mode;
+  int quote;  // Quote that closes the string
+  int sep;    // The previous byte was a separator
+  int num;    // The previous byte was part of a number
+  int kw;     // Keyword prefix matched by the word so far, as `index << 8 | length`; -1 for none
+  int delim;  // Delimiter prefix matched by the last bytes, as `index << 8 | length`
+};
+
+struct lexCompiler {
+  struct editorSyntax *syntax;
+  char *delims[2];  // Single-line and multi-line comment starts; NULL if the syntax has none
+  char *end;        // Multi-line comment end
+  const char *quotes;
+  int nocase;
+  struct lexConfig *configs;
+  int nconfigs;
+  int cap;
+  int *hash;  // Open addressing over `configs`, by `lexKey()`
+  int hashcap;
+};
+
+static int lexKeywordLen(const char *kw) {
+  int len = strlen(kw);
+  return len && kw[len - 1] == '|' ? len - 1 : len;
+}
+
+static int lexSame(struct lexCompiler *L, int a, int b) {
+  return L->nocase ? tolower(a) == tolower(b) : a == b;
+}
+
+static int lexSamePrefix(struct lexCompiler *L, const char *a, const char *b, int len) {
+  for (int j = 0; j < len; j++) {
+    if (!lexSame(L, (unsigned char)a[j], (unsigned char)b[j])) return 0;
+  }
+  return 1;
+}
+
+// The keyword prefix `kw` (or none) followed by `c`, named after the first keyword that has it
+static int lexKeywordChild(struct lexCompiler *L, int kw, int c) {
+  char **keywords = L->syntax->keywords;
+  const char *prefix = kw == -1 ? "" : keywords[kw >> 8];
+  int len = kw == -1 ? 0 : kw & 0xff;
+
+  for (int j = 0; keywords[j]; j++) {
+    if (lexKeywordLen(keywords[j]) > len && lexSamePrefix(L, keywords[j], prefix, len) &&
+        lexSame(L, (unsigned char)keywords[j][len], c)) {
+      return j << 8 | (len + 1);
+    }
+  }
+  return -1;
+}
+
+// Highlight of the keyword spelt by prefix `kw`, or `HL_NORMAL` if no keyword is that long
+static int lexKeywordHighlight(struct lexCompiler *L, int kw) {
+  char **keywords = L->syntax->keywords;
+  int len = kw & 0xff;
+
+  for (int j = 0; keywords[j]; j++) {
+    int klen = lexKeywordLen(keywords[j]);
+    if (klen == len && lexSamePrefix(L, keywords[j], keywords[kw >> 8], len)) {
+      return keywords[j][klen] == '|' ? HL_KEYWORD2 : HL_KEYWORD1;
+    }
+  }
+  return HL_NORMAL;
+}
+
+// The longest suffix of delimiter prefix `state` followed by `c` that is a prefix of one of the
+// `n` delimiters
+static int lexDelimStep(char **delims, int n, int state, int c) {
+  char s[LEX_MAX_WORD + 1];
+  int len = state & 0xff;
+
+  if (len) memcpy(s, delims[state >> 8], len);
+  s[len++] = c;
+
+  for (int l = len; l > 0; l--) {
+    for (int d = 0; d < n; d++) {
+      if (delims[d] && (int)strlen(delims[d]) >= l && !memcmp(delims[d], &s[len - l], l)) {
+        return d << 8 | l;
+      }
+    }
+  }
+  return 0;
+}
+
+// Where `k` goes on byte `c`, and how the byte (and any before it) are highlighted on the way
+static struct lexConfig lexStep(struct lexCompiler *L, struct lexConfig k, int c, struct editorLexMove *m) {
+  struct editorSyntax *syntax = L->syntax;
+  const struct lexConfig code = {LEX_CODE, 0, 1, 0, -1, 0};  // After a string or comment
+  int hl = HL_NORMAL, back = 0, back_hl = HL_NORMAL;
+
+  switch (k.mode) {
+    case LEX_LINE:
+      if (c != LEX_EOL) hl = HL_COMMENT;
+      break;
+
+    case LEX_COMMENT:
+      if (c == LEX_EOL) break;
+      hl = HL_MLCOMMENT;
+      k.delim = lexDelimStep(&L->end, 1, k.delim, c);
+      if (k.delim == (int)strlen(L->end)) k = code;
+      break;
+
+    case LEX_STRING:
+      if (c == LEX_EOL) break;
+      hl = HL_STRING;
+      if (c == '\\') {
+        k.mode = LEX_ESCAPE;
+      } else if (c == k.quote) {
+        k = code;
+      }
+      break;
+
+    case LEX_ESCAPE:
+      if (c == LEX_EOL) break;
+      hl = HL_STRING;
+      k.mode = LEX_STRING;
+      break;
+
+    case LEX_CODE: {
+      // A keyword is a whole word: it ends at a separator
+      if (k.kw != -1 && (c == LEX_EOL || is_separator(c))) {
+        back_hl = lexKeywordHighlight(L, k.kw);
+        if (back_hl != HL_NORMAL) back = k.kw & 0xff;
+      }
+      if (c == LEX_EOL) break;
+
+      // A comment delimiter takes precedence over anything its bytes looked like on their own
+      int delim = lexDelimStep(L->delims, 2, k.delim, c);
+      int d = delim >> 8, len = delim & 0xff;
+      if (len && len == (int)strlen(L->delims[d])) {
+        hl = d == 0 ? HL_COMMENT : HL_MLCOMMENT;
+        if (len > 1) {
+          back = len - 1;
+          back_hl = hl;
+        }
+        k = (struct lexConfig){d == 0 ? LEX_LINE : LEX_COMMENT, 0, 0, 0, -1, 0};
+        break;
+      }
+
+      if ((syntax->flags & HL_HIGHLIGHT_STRINGS) && c && strchr(L->quotes, c)) {
+        hl = HL_STRING;
+        k = (struct lexConfig){LEX_STRING, c, 0, 0, -1, 0};
+        break;
+      }
+
+      if ((syntax->flags & HL_HIGHLIGHT_NUMBERS) &&
+          ((isdigit(c) && (k.sep || k.num)) || (c == '.' && k.num))) {
+        hl = HL_NUMBER;
+        k = (struct lexConfig){LEX_CODE, 0, 0, 1, -1, delim};
+        break;
+      }
+
+      // Keywords start after a separator
+      if (k.kw != -1) {
+        k.kw = lexKeywordChild(L, k.kw, c);
+      } else if (k.sep) {
+        k.kw = lexKeywordChild(L, -1, c);
+      }
+      k.sep = is_separator(c);
+      k.num = 0;
+      k.delim = delim;
+      break;
+    }
+  }
+
+  m->hl = hl | back_hl << 4;
+  m->back = back;
+  return k;
+}
+
+static uint64_t lexKey(struct lexConfig *k) {
+  return (uint64_t)k->mode | (uint64_t)k->quote << 3 | (uint64_t)k->sep << 11 |
+         (uint64_t)k->num << 12 | (uint64_t)(k->delim & 0xffff) << 13 | (uint64_t)(k->kw + 1) << 29;
+}
+
+// Index of the state for `k`, added if it is new; -1 if there are too many states
+static int lexIntern(struct lexCompiler *L, struct lexConfig k) {
+  if (L->nconfigs * 2 >= L->hashcap) {
+    int cap = L->hashcap ? L->hashcap * 2 : 1024;
+    int *hash = malloc(sizeof(int) * cap);
+    memset(hash, -1, sizeof(int) * cap);
+    for (int j = 0; j < L->nconfigs; j++) {
+      uint64_t h = lexKey(&L->configs[j]) * 0x9e3779b97f4a7c15ull;
+      int slot = h >> 40 & (cap - 1);
+      while (hash[slot] != -1) slot = (slot + 1) & (cap - 1);
+      hash[slot] = j;
+    }
+    free(L->hash);
+    L->hash = hash;
+    L->hashcap = cap;
+  }
+
+  uint64_t key = lexKey(&k);
+  int slot = (key * 0x9e3779b97f4a7c15ull) >> 40 & (L->hashcap - 1);
+  while (L->hash[slot] != -1) {
+    if (lexKey(&L->configs[L->hash[slot]]) == key) return L->hash[slot];
+    slot = (slot + 1) & (L->hashcap - 1);
+  }
+
+  if (L->nconfigs > 0xffff) return -1;  // Moves hold states in 16 bits
+  if (L->nconfigs == L->cap) {
+    L->cap = L->cap ? L->cap * 2 : 256;
+    L->configs = realloc(L->configs, sizeof(struct lexConfig) * L->cap);
+  }
+  L->configs[L->nconfigs] = k;
+  L->hash[slot] = L->nconfigs;
+  return L->nconfigs++;
+}
+
+// Rejects what the DFA can't express the way the highlighter it mirrors behaves
+static int lexCheck(struct lexCompiler *L, char *err, size_t errlen) {
+  struct editorSyntax *syntax = L->syntax;
+  const char *quotes = syntax->flags & HL_HIGHLIGHT_STRINGS ? L->quotes : "";
+
+  char *words[3] = {L->delims[0], L->delims[1], L->end};
+  for (int d = 0; d < 3; d++) {
+    if (words[d] == NULL) continue;
+    if (strlen(words[d]) > LEX_MAX_WORD || strpbrk(words[d], quotes)) {
+      snprintf(err, errlen, "comment delimiter %.20s is too long or holds a quote", words[d]);
+      return -1;
+    }
+  }
+  if (L->delims[0] && L->delims[1] && strncmp(L->delims[0], L->delims[1], strlen(L->delims[0])) &&
+      (strstr(L->delims[0], L->delims[1]) || strstr(L->delims[1] + 1, L->delims[0]))) {
+    snprintf(err, errlen, "comment delimiters %.20s and %.20s overlap", L->delims[0], L->delims[1]);
+    return -1;
+  }
+
+  for (int j = 0; syntax->keywords[j]; j++) {
+    char *kw = syntax->keywords[j];
+    int len = lexKeywordLen(kw);
+    int bad = len == 0 || len > LEX_MAX_WORD || isdigit((unsigned char)kw[0]);
+    for (int i = 0; i < len && !bad; i++) {
+      int c = (unsigned char)kw[i];
+      bad = is_separator(c) || strchr(quotes, c) || (L->delims[0] && c == L->delims[0][0]) ||
+            (L->delims[1] && c == L->delims[1][0]);
+    }
+    if (bad) {
+      snprintf(err, errlen, "keyword %.20s can't be highlighted as a word", kw);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+// What tells byte `c` apart from others: bytes with the same signature step alike in every state
+static int lexSignature(struct lexCompiler *L, int c) {
+  struct editorSyntax *syntax = L->syntax;
+
+  for (int d = 0; d < 2; d++) {
+    if (L->delims[d] && memchr(L->delims[d], c, strlen(L->delims[d]))) return 0x100 | c;
+  }
+  if (L->end && memchr(L->end, c, strlen(L->end))) return 0x100 | c;
+  for (int j = 0; syntax->keywords[j]; j++) {
+    for (char *p = syntax->keywords[j]; *p && *p != '|'; p++) {
+      if (lexSame(L, (unsigned char)*p, c)) return 0x200 | (L->nocase ? tolower(c) : c);
+    }
+  }
+
+  const char *quote = (syntax->flags & HL_HIGHLIGHT_STRINGS) && c ? strchr(L->quotes, c) : NULL;
+  return is_separator(c) | !!isdigit(c) << 1 | (c == '.') << 2 | (c == '\\') << 3 |
+         (quote ? quote - L->quotes + 1 : 0) << 4;
+}
+
+// Compiles `syntax` into a lexer. Returns NULL with the reason in `err` if it can't be.
+struct editorLexer *editorLexerCompile(struct editorSyntax *syntax, char *err, size_t errlen) {
+  TRACE_BEGIN("editorLexerCompile");
+  struct lexCompiler L = {0};
+  L.syntax = syntax;
+  L.nocase = syntax->flags & HL_IGNORE_CASE;
+  char *scs = syntax->singleline_comment_start;
+  char *mcs = syntax->multiline_comment_start;
+  char *mce = syntax->multiline_comment_end;
+  L.delims[0] = scs && *scs ? scs : NULL;
+  if (mcs && *mcs && mce && *mce) {
+    L.delims[1] = mcs;
+    L.end = mce;
+  }
+  L.quotes = syntax->quotes ? syntax->quotes : "\"'";
+  if (lexCheck(&L, err, errlen) == -1) {
+    TRACE_END("editorLexerCompile");
+    return NULL;
+  }
+
+  struct editorLexer *X = calloc(1, sizeof(struct editorLexer));
+  int reps[LEX_EOL + 1];  // A byte of each class
+  int sigs[LEX_EOL];
+  int nsigs = 0;
+  for (int c = 0; c < 256; c++) {
+    int sig = lexSignature(&L, c);
+    int cls = 0;
+    while (cls < nsigs && sigs[cls] != sig) cls++;
+    if (cls == nsigs) {
+      sigs[nsigs++] = sig;
+      reps[cls] = c;
+    }
+    X->classes[c] = cls;
+  }
+  reps[nsigs] = LEX_EOL;
+  X->nclasses = nsigs + 1;
+
+  lexIntern(&L, (struct lexConfig){LEX_CODE, 0, 1, 0, -1, 0});
+  X->comment = L.end ? lexIntern(&L, (struct lexConfig){LEX_COMMENT, 0, 0, 0, -1, 0}) : 0;
+
+  for (int s = 0; s < L.nconfigs; s++) {
+    X->moves = realloc(X->moves, sizeof(struct editorLexMove) * X->nclasses * L.cap);
+    for (int cls = 0; cls < X->nclasses; cls++) {
+      struct editorLexMove *m = &X->moves[s * X->nclasses + cls];
+      int next = lexIntern(&L, lexStep(&L, L.configs[s], reps[cls], m));
+      if (next == -1) {
+        snprintf(err, errlen, "%s has too many keywords to compile", syntax->filetype);
+        editorLexerFree(X);
+        X = NULL;
+        goto done;
+      }
+      m->next = reps[cls] == LEX_EOL ? s : next;
+    }
+  }
+
+  X->nstates = L.nconfigs;
+  X->open = malloc((unsigned)X->nstates);
+  for (int s = 0; s < X->nstates; s++) X->open[s] = L.configs[s].mode == LEX_COMMENT;
+
+done:
+  free(L.configs);
+  free(L.hash);
+  TRACE_END("editorLexerCompile");
+  return X;
+}
+
+void editorLexerFree(struct editorLexer *X) {
+  if (X == NULL) return;
+  free(X->moves);
+  free(X->open);
+  free(X);
+}
+
+/*** lexer cache ***/
+
+// Compiled lexers are cached next to their definition, in `.<name>.lex`. The header pins the
+// definition's size and mtime; a cache that doesn't match, or doesn't add up, is ignored.
+
+struct lexCacheHeader {
+  char magic[4];
+  uint32_t nstates;
+  uint32_t nclasses;
+  uint32_t comment;
+  int64_t size;
+  int64_t mtime;
+  int64_t mtime_nsec;
+};
+
+static char *lexCachePath(const char *path) {
+  const char *slash = strrchr(path, '/');
+  int dirlen = slash ? slash - path + 1 : 0;
+  char *cache = malloc(strlen(path) + 6);
+
+  memcpy(cache, path, dirlen);
+  strcpy(&cache[dirlen], ".");
+  strcat(cache, &path[dirlen]);
+  strcat(cache, ".lex");
+  return cache;
+}
+
+static void lexCacheHeader(struct lexCacheHeader *h, const struct stat *st) {
+  memset(h, 0, sizeof(*h));
+  memcpy(h->magic, LEX_CACHE_MAGIC, 4);
+  h->size = st->st_size;
+  h->mtime = st->st_mtim.tv_sec;
+  h->mtime_nsec = st->st_mtim.tv_nsec;
+}
+
+// Whether a lexer read from a cache is one the compiler could have produced. Its highlights must
+// be ones the themes have styles for. A move's `back` must not reach before the start of the
+// row, so it may not exceed the fewest bytes in which a row can reach the move's state.
+static int lexCacheValid(struct editorLexer *X) {
+  for (int c = 0; c < 256; c++) {
+    if (X->classes[c] >= X->nclasses - 1) return 0;
+  }
+
+  // Bytes from the start of a row to each state, breadth first, up to the longest word
+  int *depth = malloc(sizeof(int) * X->nstates);
+  int *queue = malloc(sizeof(int) * X->nstates);
+  for (int s = 0; s < X->nstates; s++) depth[s] = INT_MAX;
+  int head = 0, tail = 0;
+  depth[0] = 0;
+  queue[tail++] = 0;
+  if (depth[X->comment] != 0) {
+    depth[X->comment] = 0;
+    queue[tail++] = X->comment;
+  }
+
+  int ok = 1;
+  while (head < tail && ok) {
+    int s = queue[head++];
+    for (int c = 0; c < X->nclasses && ok; c++) {
+      struct editorLexMove *m = &X->moves[(size_t)s * X->nclasses + c];
+      ok = m->next < X->nstates && (m->hl & 0xf) < HL_CLASSES && (m->hl >> 4) < HL_CLASSES &&
+           m->back <= LEX_MAX_WORD && m->back <= depth[s];
+      if (ok && c < X->nclasses - 1 && depth[m->next] == INT_MAX) {
+        depth[m->next] = depth[s] + 1 > LEX_MAX_WORD ? LEX_MAX_WORD : depth[s] + 1;
+        queue[tail++] = m->next;
+      }
+    }
+  }
+
+  // States no row can reach are never used, but are still checked for where they lead
+  for (size_t j = 0; j < (size_t)X->nstates * X->nclasses && ok; j++) ok = X->moves[j].next < X->nstates;
+
+  free(depth);
+  free(queue);
+  return ok;
+}
+
+// The cached lexer for the definition at `path` (as it is in `st`), or NULL
+struct editorLexer *editorLexerLoad(const char *path, const struct stat *st) {
+  char *cache = lexCachePath(path);
+  int fd = open(cache, O_RDONLY);
+  free(cache);
+  if (fd == -1) return NULL;
+
+  struct lexCacheHeader want, h;
+  lexCacheHeader(&want, st);
+  struct stat cst;
+  if (fstat(fd, &cst) == -1 || read(fd, &h, sizeof(h)) != sizeof(h) ||
+      memcmp(h.magic, want.magic, 4) || h.size != want.size || h.mtime != want.mtime ||
+      h.mtime_nsec != want.mtime_nsec || h.nclasses < 2 || h.nclasses > LEX_EOL + 1 ||
+      h.nstates == 0 || h.nstates > 0x10000 || h.comment >= h.nstates) {
+    close(fd);
+    return NULL;
+  }
+
+  size_t nmoves = (size_t)h.nstates * h.nclasses;
+  if ((size_t)cst.st_size != sizeof(h) + 256 + sizeof(struct editorLexMove) * nmoves + h.nstates) {
+    close(fd);
+    return NULL;
+  }
+
+  struct editorLexer *X = calloc(1, sizeof(struct editorLexer));
+  X->nstates = h.nstates;
+  X->nclasses = h.nclasses;
+  X->comment = h.comment;
+  X->moves = malloc(sizeof(struct editorLexMove) * nmoves);
+  X->open = malloc(X->nstates);
+  int ok = read(fd, X->classes, 256) == 256 &&
+           read(fd, X->moves, sizeof(struct editorLexMove) * nmoves) == (ssize_t)(sizeof(struct editorLexMove) * nmoves) &&
+           read(fd, X->open, X->nstates) == X->nstates;
+  close(fd);
+
+  if (!ok || !lexCacheValid(X)) {
+    editorLexerFree(X);
+    return NULL;
+  }
+  return X;
+}
+
+// Caches `X` for the definition at `path`. Best effort: a directory we can't write to just
+// means compiling again next time.
+void editorLexerSave(const char *path, const struct stat *st, struct editorLexer *X) {
+  char *cache = lexCachePath(path);
+  char *tmp = malloc(strlen(cache) + 16);
+  sprintf(tmp, "%s.%d", cache, (int)getpid());
+
+  int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd != -1) {
+    struct lexCacheHeader h;
+    lexCacheHeader(&h, st);
+    h.nstates = X->nstates;
+    h.nclasses = X->nclasses;
+    h.comment = X->comment;
+
+    size_t moves = sizeof(struct editorLexMove) * X->nstates * X->nclasses;
+    int ok = write(fd, &h, sizeof(h)) == sizeof(h) && write(fd, X->classes, 256) == 256 &&
+             write(fd, X->moves, moves) == (ssize_t)moves && write(fd, X->open, X->nstates) == X->nstates;
+    close(fd);
+    if (!ok || rename(tmp, cache) == -1) unlink(tmp);
+  }
+
+  free(tmp);
+  free(cache);
+}
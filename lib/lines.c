@@ -0,0 +1,119 @@
+/*** includes ***/
+
+// Feature test macros (portability): https://www.gnu.org/software/libc/manual/html_node/Feature-Test-Macros.html
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+
+#include "editor.h"
+
+/*** line index ***/
+
+// Byte offsets of rows in the text as it would be saved (one `\n` after each row), for jumps to
+// an offset. The offset of every `LINES_STRIDE`th row is kept; an edit invalidates the entries
+// after its row, and they are summed again only when next asked for. A lookup binary-searches
+// the entries and then walks at most `LINES_STRIDE` rows. Pagers answer from their own index.
+
+#define LINES_STRIDE 256
+
+// Row `at` was edited, inserted or deleted
+void editorLinesChanged(struct editorBuffer *B, int at) {
+  int k = at / LINES_STRIDE + 1;  // Entries up to row `at` are unaffected
+  if (B->line_offsets_valid > k) B->line_offsets_valid = k;
+}
+
+static void editorLinesUpdate(struct editorBuffer *B) {
+  int n = B->numrows / LINES_STRIDE + 1;
+  if (B->line_offsets_valid >= n) return;
+
+  if (n > B->line_offsets_cap) {
+    while (B->line_offsets_cap < n) B->line_offsets_cap = B->line_offsets_cap ? B->line_offsets_cap * 2 : 16;
+    B->line_offsets = realloc(B->line_offsets, sizeof(long long) * B->line_offsets_cap);
+  }
+
+  B->line_offsets[0] = 0;
+  for (int k = B->line_offsets_valid > 0 ? B->line_offsets_valid : 1; k < n; k++) {
+    long long off = B->line_offsets[k - 1];
+    for (int y = (k - 1) * LINES_STRIDE; y < k * LINES_STRIDE; y++) off += B->row[y].size + 1;
+    B->line_offsets[k] = off;
+  }
+  B->line_offsets_valid = n;
+}
+
+// Byte offset of row `y`; for `y` past the last row, the end of the text
+long long editorLineOffset(struct editorBuffer *B, int y) {
+  if (y < 0) y = 0;
+  if (y > B->numrows) y = B->numrows;
+  if (B->pager) return editorPagerLineOffset(B, y);
+
+  editorLinesUpdate(B);
+  long long off = B->line_offsets[y / LINES_STRIDE];
+  for (int j = y / LINES_STRIDE * LINES_STRIDE; j < y; j++) off += B->row[j].size + 1;
+  return off;
+}
+
+// Row holding byte `off`, and the byte's column in it in `cx`; past the end, the end of the last row
+int editorLineAt(struct editorBuffer *B, long long off, int *cx) {
+  if (off < 0) off = 0;
+  if (B->pager) {
+    int y = editorPagerLineAt(B, off);
+    long long col = off - editorPagerLineOffset(B, y);
+    erow *row = editorRow(B, y);
+    *cx = col < row->size ? col : row->size;
+    return y;
+  }
+  *cx = 0;
+  if (B->numrows == 0) return 0;
+
+  editorLinesUpdate(B);
+  int lo = 0, hi = B->numrows / LINES_STRIDE;
+  while (lo < hi) {
+    int mid = (lo + hi + 1) / 2;
+    if (B->line_offsets[mid] <= off) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+
+  long long start = B->line_offsets[lo];
+  int y = lo * LINES_STRIDE;
+  while (y < B->numrows - 1 && start + B->row[y].size + 1 <= off) start += B->row[y++].size + 1;
+  *cx = off - start < B->row[y].size ? off - start : B->row[y].size;
+  return y;
+}
+
+// Moves the cursor to `where`: a line number, a percentage through the buffer (`50%`) or a byte
+// offset (`@4096`), and scrolls it to the middle of the window. Returns -1 if `where` is none.
+int editorGoto(struct editorConfig *E, const char *where) {
+  struct editorBuffer *B = E->buf;
+  char *end;
+  int y, cx = 0;
+
+  if (where[0] == '@') {
+    long long off = strtoll(where + 1, &end, 10);
+    if (end == where + 1) return -1;
+    y = editorLineAt(B, off, &cx);
+  } else {
+    double n = strtod(where, &end);
+    if (end == where || n != n) return -1;
+    if (*end == '%') {
+      end++;
+      n = n / 100 * B->numrows;
+    } else {
+      n = n - 1;  // Lines are numbered from 1
+    }
+    if (n > B->numrows - 1) n = B->numrows - 1;
+    if (n < 0) n = 0;
+    y = n;
+  }
+  if (*end != '\0') return -1;
+
+  B->cy = y;
+  B->cx = cx;
+  B->rowoff = y - E->win->rows / 2;
+  if (B->rowoff < 0) B->rowoff = 0;
+  return 0;
+}
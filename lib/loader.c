@@ -0,0 +1,303 @@
+/*** includes ***/
+
+// Feature test macros (portability): https://www.gnu.org/software/libc/manual/html_node/Feature-Test-Macros.html
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "editor.h"
+
+/*** loader ***/
+
+// Progressive loading. A worker thread reads the file, decompressing it if need be, and publishes
+// its lines in batches; the main thread turns them into rows from `editorPoll()`, a bounded
+// number at a time, so the first screen can be drawn as soon as its lines arrive and keys are
+// never kept waiting. A plain regular file is mapped instead: its first lines are published as
+// a batch, and the rest is built on all cores by `editorIndexNew()` a slice at a time, each slice
+// handed over as soon as it is built.
+
+#define LOAD_FIRST_BATCH 256       // Lines; about a screenful, so the first frame is quick
+#define LOAD_MAX_BATCH 16384       // Batches double in size up to this many lines
+#define LOAD_POLL_ROWS 32768       // Rows turned into `erow`s per poll on the main thread
+#define LOAD_FIRST_SLICE (1 << 20)   // Bytes of the mapped file indexed at once, doubling up to
+#define LOAD_MAX_SLICE (64 << 20)    // this many
+
+struct editorLoadBatch {
+  struct editorLoadBatch *next;
+  char *data;    // Lines back to back, without their newlines
+  int *offsets;  // `nlines + 1` offsets into `data`
+  int nlines;
+  int consumed;  // Lines already inserted by the main thread
+  struct editorIndex *index;  // Rows built from a slice of a mapped file, instead of lines
+  long long bytes;            // Of the file, once the batch is consumed
+};
+
+struct editorLoader {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  struct editorLoadBatch *head, *tail;  // Published and not yet fully consumed
+  struct editorReader *reader;
+  long long total;  // File size in bytes
+  int finished;     // Worker has published everything it will
+  int cancel;
+
+  int fd;
+  int mapped;        // Index the file rather than read it line by line
+  struct editorSyntax *syntax;
+  long long reached;  // Bytes of the mapped file in the buffer's rows (main thread only)
+};
+
+static void editorLoadPublish(struct editorLoader *L, struct editorLoadBatch *batch) {
+  pthread_mutex_lock(&L->lock);
+  if (L->tail) {
+    L->tail->next = batch;
+  } else {
+    L->head = batch;
+  }
+  L->tail = batch;
+  pthread_mutex_unlock(&L->lock);
+}
+
+static void editorLoadBatchFree(struct editorLoadBatch *batch) {
+  if (batch->index) editorIndexFree(batch->index);
+  free(batch->data);
+  free(batch->offsets);
+  free(batch);
+}
+
+static struct editorLoadBatch *editorLoadBatchNew(struct abuf *data, int *offsets, int nlines) {
+  struct editorLoadBatch *batch = calloc(1, sizeof(struct editorLoadBatch));
+  batch->data = data->b;
+  batch->offsets = offsets;
+  batch->nlines = nlines;
+  return batch;
+}
+
+// Publishes the first screenful of the mapped file, then indexes the rest in slices of whole
+// lines, publishing each as it is built. Returns -1, having done nothing, if the file can't be
+// mapped.
+static int editorLoadMapped(struct editorLoader *L) {
+  if (L->total <= 0) return -1;
+  const char *data = mmap(NULL, L->total, PROT_READ, MAP_PRIVATE, L->fd, 0);
+  if (data == MAP_FAILED) return -1;
+  madvise((void *)data, L->total, MADV_SEQUENTIAL);
+
+  const char *end = data + L->total;
+  const char *p = data;
+  struct abuf first = ABUF_INIT;
+  int *offsets = malloc(sizeof(int) * (LOAD_FIRST_BATCH + 1));
+  int nlines = 0;
+  offsets[0] = 0;
+
+  while (p < end && nlines < LOAD_FIRST_BATCH) {
+    const char *nl = memchr(p, '\n', end - p);
+    const char *eol = nl ? nl : end;
+    size_t len = eol - p;
+    while (len > 0 && p[len - 1] == '\r') len--;
+    abAppend(&first, p, len);
+    offsets[++nlines] = first.len;
+    p = eol < end ? eol + 1 : end;
+  }
+  if (nlines > 0) {
+    struct editorLoadBatch *batch = editorLoadBatchNew(&first, offsets, nlines);
+    batch->bytes = p - data;
+    editorLoadPublish(L, batch);
+  } else {
+    free(offsets);
+  }
+
+  int base = nlines;
+  size_t slice = LOAD_FIRST_SLICE;
+  while (p < end) {
+    const char *q = (size_t)(end - p) > slice ? p + slice : end;
+    const char *nl = q < end ? memchr(q, '\n', end - q) : NULL;
+    q = nl ? nl + 1 : end;
+
+    struct editorIndex *X = editorIndexNew(L->syntax, p, q - p, base, 0, &L->cancel);
+    if (X == NULL) break;  // Cancelled
+    struct editorLoadBatch *batch = calloc(1, sizeof(struct editorLoadBatch));
+    batch->index = X;
+    batch->bytes = q - p;
+    editorLoadPublish(L, batch);
+
+    base += editorIndexRows(X);
+    p = q;
+    if (slice < LOAD_MAX_SLICE) slice *= 2;
+  }
+  munmap((void *)data, L->total);
+  return 0;
+}
+
+static void *editorLoadWorker(void *arg) {
+  struct editorLoader *L = arg;
+  if (L->mapped && editorLoadMapped(L) == 0) {
+    __atomic_store_n(&L->finished, 1, __ATOMIC_RELEASE);
+    return NULL;
+  }
+  __atomic_store_n(&L->mapped, 0, __ATOMIC_RELAXED);
+
+  char *line;
+  ssize_t linelen;
+  int target = LOAD_FIRST_BATCH;
+
+  struct abuf data = ABUF_INIT;
+  int *offsets = malloc(sizeof(int) * (target + 1));
+  int nlines = 0;
+  offsets[0] = 0;
+
+  while (!__atomic_load_n(&L->cancel, __ATOMIC_RELAXED) &&
+         (linelen = editorReaderLine(L->reader, &line)) != -1) {
+    abAppend(&data, line, linelen);
+    offsets[++nlines] = data.len;
+
+    if (nlines == target) {
+      editorLoadPublish(L, editorLoadBatchNew(&data, offsets, nlines));
+
+      if (target < LOAD_MAX_BATCH) target *= 2;
+      data.b = NULL;
+      data.len = 0;
+      offsets = malloc(sizeof(int) * (target + 1));
+      offsets[0] = 0;
+      nlines = 0;
+    }
+  }
+
+  if (nlines > 0) {
+    editorLoadPublish(L, editorLoadBatchNew(&data, offsets, nlines));
+  } else {
+    abFree(&data);
+    free(offsets);
+  }
+
+  __atomic_store_n(&L->finished, 1, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+// Starts loading `filename` into the (empty) buffer in the background. Returns -1 with `errno`
+// set if the file can't be opened.
+int editorOpenAsync(struct editorBuffer *B, char *filename) {
+  editorSetFilename(B, filename);
+
+  FILE *fp = fopen(filename, "r");
+  if (!fp) return -1;
+
+  struct editorLoader *L = calloc(1, sizeof(struct editorLoader));
+  struct stat st;
+  L->total = fstat(fileno(fp), &st) == 0 ? st.st_size : 0;
+  if ((L->reader = editorReaderOpen(fp)) == NULL) {
+    free(L);
+    return -1;
+  }
+  B->compression = editorReaderCompression(L->reader);
+  L->fd = fileno(fp);
+  L->mapped = L->total > 0 && B->compression == COMPRESS_NONE && S_ISREG(st.st_mode);
+  L->syntax = B->syntax;
+  pthread_mutex_init(&L->lock, NULL);
+
+  if (pthread_create(&L->thread, NULL, editorLoadWorker, L) != 0) {
+    pthread_mutex_destroy(&L->lock);
+    editorReaderClose(L->reader);
+    free(L);
+    return editorOpen(B, filename);  // No thread to spare: load synchronously instead
+  }
+
+  B->loader = L;
+  B->journal.suspended++;  // Loading is not an edit
+  return 0;
+}
+
+static void editorLoaderFree(struct editorBuffer *B) {
+  struct editorLoader *L = B->loader;
+
+  pthread_join(L->thread, NULL);
+  while (L->head) {
+    struct editorLoadBatch *next = L->head->next;
+    editorLoadBatchFree(L->head);
+    L->head = next;
+  }
+  pthread_mutex_destroy(&L->lock);
+  B->truncated = editorReaderError(L->reader);
+  editorReaderClose(L->reader);
+  free(L);
+
+  B->loader = NULL;
+  B->journal.suspended--;
+}
+
+// Inserts up to `LOAD_POLL_ROWS` published lines. Returns non-zero if rows were added or the
+// load completed.
+int editorLoaderPoll(struct editorBuffer *B) {
+  struct editorLoader *L = B->loader;
+  if (L == NULL) return 0;
+
+  // Read `finished` before draining, so no batch published before it can be missed
+  int finished = __atomic_load_n(&L->finished, __ATOMIC_ACQUIRE);
+  int budget = LOAD_POLL_ROWS;
+  int added = 0;
+
+  TRACE_BEGIN("editorLoaderPoll");
+  while (budget > 0) {
+    pthread_mutex_lock(&L->lock);
+    struct editorLoadBatch *batch = L->head;
+    pthread_mutex_unlock(&L->lock);
+    if (batch == NULL) break;
+
+    // Only the main thread consumes or unlinks batches, so `batch` stays valid unlocked
+    if (batch->index) {
+      int n = editorIndexRows(batch->index);
+      editorIndexAdopt(B, batch->index);
+      batch->index = NULL;
+      budget -= n;
+      added += n;
+    }
+    while (batch->consumed < batch->nlines && budget > 0) {
+      int j = batch->consumed++;
+      editorInsertRow(B, B->numrows, &batch->data[batch->offsets[j]],
+                      batch->offsets[j + 1] - batch->offsets[j]);
+      budget--;
+      added++;
+    }
+    if (batch->consumed < batch->nlines) break;
+
+    pthread_mutex_lock(&L->lock);
+    L->head = batch->next;
+    if (L->head == NULL) L->tail = NULL;
+    pthread_mutex_unlock(&L->lock);
+    L->reached += batch->bytes;
+    editorLoadBatchFree(batch);
+  }
+  TRACE_END("editorLoaderPoll");
+
+  B->dirty = 0;
+  if (finished && L->head == NULL) {
+    editorLoaderFree(B);
+    editorOpenFinish(B);
+    return 1;
+  }
+  return added;
+}
+
+// Percentage of the file read so far; of a mapped file, the part already in the buffer's rows
+int editorLoaderProgress(struct editorBuffer *B) {
+  struct editorLoader *L = B->loader;
+  if (L == NULL) return 100;
+  if (L->total <= 0) return 0;
+
+  long long done = __atomic_load_n(&L->mapped, __ATOMIC_RELAXED) ? L->reached : editorReaderOffset(L->reader);
+  return (int)(done * 100 / L->total);
+}
+
+// Stops a load in progress, keeping the rows already inserted
+void editorLoaderCancel(struct editorBuffer *B) {
+  if (B->loader == NULL) return;
+  __atomic_store_n(&B->loader->cancel, 1, __ATOMIC_RELAXED);
+  editorLoaderFree(B);
+}
@@ -0,0 +1,54 @@
+/*** includes ***/
+
+#include <stdlib.h>
+
+#include "editor.h"
+
+/*** macro ***/
+
+// Keyboard macros: the keys read while recording, fed back in place of the terminal's on
+// replay. The front end replays them through its usual key handling with nothing drawn until the
+// end, so a run costs only the edits themselves.
+
+// Starts recording, discarding the previous macro
+void editorMacroStart(struct editorConfig *E) {
+  struct editorMacro *M = &E->macro;
+  M->len = 0;
+  M->recording = 1;
+}
+
+// Stops recording. The key that stopped it is not part of the macro. Returns the keys recorded.
+int editorMacroStop(struct editorConfig *E) {
+  struct editorMacro *M = &E->macro;
+  M->recording = 0;
+  if (M->len > 0) M->len--;
+  return M->len;
+}
+
+// Appends a key read from the terminal, if recording
+void editorMacroRecord(struct editorConfig *E, int key) {
+  struct editorMacro *M = &E->macro;
+  if (!M->recording || M->playing) return;
+
+  if (M->len == M->cap) {
+    M->cap = M->cap ? M->cap * 2 : 64;
+    M->keys = realloc(M->keys, sizeof(int) * M->cap);
+  }
+  M->keys[M->len++] = key;
+}
+
+// The next key of a replay. Prompts still open when the keys run out, or once a search in the
+// run has failed, are cancelled.
+int editorMacroNext(struct editorConfig *E) {
+  struct editorMacro *M = &E->macro;
+  if (M->pos == M->len || E->find.misses != M->misses) return '\x1b';
+  return M->keys[M->pos++];
+}
+
+void editorMacroFree(struct editorConfig *E) {
+  struct editorMacro *M = &E->macro;
+  free(M->keys);
+  M->keys = NULL;
+  M->len = M->cap = 0;
+  M->recording = M->playing = 0;
+}
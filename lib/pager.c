@@ -0,0 +1,314 @@
+/*** includes ***/
+
+// Feature test macros (portability): https://www.gnu.org/software/libc/manual/html_node/Feature-Test-Macros.html
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "editor.h"
+
+/*** pager ***/
+
+// Read-only view of a file too big to hold as rows (`-R`). The file stays mapped; a sparse
+// index records the byte offset of every `PAGER_STRIDE`th line, and the lines in between are
+// found with `memchr()` when needed. Only rows being looked at are materialised, into a small
+// direct-mapped cache of slots whose buffers are reused, so memory does not grow with the file. Highlighting needs the comment state at the start of a line: it is kept
+// per checkpoint, computed forward from the nearest known one, or re-synchronised from a few
+// checkpoints back (assuming code, not comment) when the nearest known one is far away.
+
+#define PAGER_STRIDE 256   // Lines between checkpoints
+#define PAGER_SLOTS 512    // Rows materialised at a time; more than any screen shows
+#define PAGER_SYNC 4       // Checkpoints scanned to guess an unknown comment state
+
+struct editorPagerSlot {
+  int line;     // -1 if empty
+  off_t start;  // Byte offset of the line
+  off_t next;   // Byte offset of the line after it
+  int exact;    // Highlighted from a known comment state rather than a guess
+  erow row;
+};
+
+struct editorPager {
+  const char *data;
+  off_t size;
+  off_t *checkpoints;   // Offset of line `k * PAGER_STRIDE`
+  signed char *states;  // Comment state at each checkpoint; -1 until known
+  int ncheckpoints;
+  struct editorSyntax *syntax;  // Filetype the slots and states were computed for
+  struct editorPagerSlot slots[PAGER_SLOTS];
+  erow scratch;  // For lines scanned only for their comment state
+};
+
+// Maps `filename` read-only into the empty buffer `B`. Returns -1 with `errno` set if it is not a
+// plain regular file that can be mapped.
+int editorPagerOpen(struct editorBuffer *B, char *filename) {
+  editorSetFilename(B, filename);
+
+  int fd = open(filename, O_RDONLY);
+  if (fd == -1) return -1;
+
+  struct stat st;
+  unsigned char magic[4] = {0};
+  if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || read(fd, magic, 4) == -1) {
+    close(fd);
+    return -1;
+  }
+  if ((magic[0] == 0x1f && magic[1] == 0x8b) || !memcmp(magic, "\x28\xb5\x2f\xfd", 4)) {
+    close(fd);
+    errno = ENOTSUP;  // Compressed: there is no text to map
+    return -1;
+  }
+
+  const char *data = NULL;
+  if (st.st_size > 0) {
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      close(fd);
+      return -1;
+    }
+  }
+  close(fd);
+  TRACE_BEGIN("editorPagerOpen");
+
+  struct editorPager *P = calloc(1, sizeof(struct editorPager));
+  P->data = data;
+  P->size = st.st_size;
+  for (int j = 0; j < PAGER_SLOTS; j++) P->slots[j].line = -1;
+
+  // One pass over the file for the line count and the checkpoints
+  int cap = 16;
+  int lines = 0;
+  P->checkpoints = malloc(sizeof(off_t) * cap);
+  const char *p = data;
+  const char *end = data + st.st_size;
+  while (p < end) {
+    if (lines % PAGER_STRIDE == 0) {
+      if (P->ncheckpoints == cap) {
+        cap *= 2;
+        P->checkpoints = realloc(P->checkpoints, sizeof(off_t) * cap);
+      }
+      P->checkpoints[P->ncheckpoints++] = p - data;
+    }
+    lines++;
+
+    const char *nl = memchr(p, '\n', end - p);
+    p = nl ? nl + 1 : end;
+  }
+
+  P->states = malloc(P->ncheckpoints ? P->ncheckpoints : 1);
+  memset(P->states, -1, P->ncheckpoints);
+  if (P->ncheckpoints) P->states[0] = 0;
+
+  B->pager = P;
+  B->numrows = lines;
+  B->dirty = 0;
+  TRACE_END("editorPagerOpen");
+  return 0;
+}
+
+void editorPagerFree(struct editorBuffer *B) {
+  struct editorPager *P = B->pager;
+  if (P == NULL) return;
+
+  for (int j = 0; j < PAGER_SLOTS; j++) editorFreeRow(B, &P->slots[j].row);
+  editorFreeRow(B, &P->scratch);
+
+  if (P->data) munmap((void *)P->data, P->size);
+  free(P->checkpoints);
+  free(P->states);
+  free(P);
+  B->pager = NULL;
+}
+
+// The line starting at `start`: its length without the line ending, and where the next begins
+static int pagerLineAt(struct editorPager *P, off_t start, off_t *next) {
+  const char *s = P->data + start;
+  const char *nl = memchr(s, '\n', P->size - start);
+  int len = nl ? nl - s : P->size - start;
+
+  *next = nl ? nl - P->data + 1 : P->size;
+  while (len > 0 && s[len - 1] == '\r') len--;
+  return len;
+}
+
+// Byte offset of line `y`
+static off_t pagerLineOffset(struct editorPager *P, int y) {
+  struct editorPagerSlot *prev = y > 0 ? &P->slots[(y - 1) % PAGER_SLOTS] : NULL;
+  if (prev && prev->line == y - 1) return prev->next;
+
+  off_t off = P->checkpoints[y / PAGER_STRIDE];
+  for (int j = y % PAGER_STRIDE; j > 0; j--) pagerLineAt(P, off, &off);
+  return off;
+}
+
+// Builds `row` from the line starting at `start`. Its text is copied out of the mapping, so it is
+// terminated like any row's and can be shared with `render`.
+static void pagerLoadRow(struct editorBuffer *B, erow *row, off_t start, off_t *next) {
+  struct editorPager *P = B->pager;
+
+  row->size = pagerLineAt(P, start, next);
+  row->chars = poolRealloc(B->pool, row->chars, row->size + 1);
+  memcpy(row->chars, P->data + start, row->size);
+  row->chars[row->size] = '\0';
+  editorRenderRow(B->pool, row);
+}
+
+// Highlights the line starting at `start` into the scratch row; returns its end comment state
+static int pagerScan(struct editorBuffer *B, off_t start, off_t *next, int in_comment) {
+  erow *row = &B->pager->scratch;
+
+  pagerLoadRow(B, row, start, next);
+  return editorHighlightRow(B->pool, B->syntax, row, in_comment);
+}
+
+// Comment state at checkpoint `k`; `exact` is cleared if it is a guess
+static int pagerCheckpointState(struct editorBuffer *B, int k, int *exact) {
+  struct editorPager *P = B->pager;
+  *exact = 1;
+  if (P->states[k] != -1) return P->states[k];
+
+  int known = k;
+  while (known > 0 && P->states[known] == -1 && k - known < PAGER_SYNC) known--;
+
+  // Too far from a known state: guess that the text a few checkpoints back is code, and don't
+  // remember what follows from a guess
+  *exact = P->states[known] != -1;
+  int state = *exact ? P->states[known] : 0;
+
+  for (int c = known; c < k; c++) {
+    off_t off = P->checkpoints[c];
+    for (int j = 0; j < PAGER_STRIDE; j++) state = pagerScan(B, off, &off, state);
+    if (*exact) P->states[c + 1] = state;
+  }
+  return state;
+}
+
+// Comment state at the start of line `y`; `exact` is cleared if it is a guess
+static int pagerLineState(struct editorBuffer *B, int y, int *exact) {
+  struct editorPager *P = B->pager;
+  struct editorSyntax *syntax = B->syntax;
+  *exact = 1;
+  if (syntax == NULL || syntax->multiline_comment_start == NULL || y == 0) return 0;
+
+  struct editorPagerSlot *prev = &P->slots[(y - 1) % PAGER_SLOTS];
+  if (prev->line == y - 1) {
+    *exact = prev->exact;
+    return prev->row.hl_open_comment;
+  }
+
+  int state = pagerCheckpointState(B, y / PAGER_STRIDE, exact);
+  off_t off = P->checkpoints[y / PAGER_STRIDE];
+  for (int j = y % PAGER_STRIDE; j > 0; j--) state = pagerScan(B, off, &off, state);
+  return state;
+}
+
+// The row for line `y`. It stays valid until another line that maps to the same slot is read.
+erow *editorPagerRow(struct editorBuffer *B, int y) {
+  struct editorPager *P = B->pager;
+  struct editorPagerSlot *S = &P->slots[y % PAGER_SLOTS];
+
+  // A new filetype invalidates every slot and every checkpoint state
+  if (P->syntax != B->syntax) {
+    P->syntax = B->syntax;
+    for (int j = 0; j < PAGER_SLOTS; j++) P->slots[j].line = -1;
+    memset(P->states, -1, P->ncheckpoints);
+    if (P->ncheckpoints) P->states[0] = 0;
+  }
+  if (S->line == y) return &S->row;
+
+  int state = pagerLineState(B, y, &S->exact);
+  if (S->exact && y % PAGER_STRIDE == 0) P->states[y / PAGER_STRIDE] = state;  // Reached by scrolling
+  S->start = pagerLineOffset(P, y);
+  S->row.idx = y;
+  pagerLoadRow(B, &S->row, S->start, &S->next);
+  S->row.hl_open_comment = editorHighlightRow(B->pool, B->syntax, &S->row, state);
+  S->line = y;
+  return &S->row;
+}
+
+// Line containing byte `off`: the last checkpoint at or before it, then newlines up to it
+static int pagerLineOfOffset(struct editorPager *P, off_t off) {
+  int lo = 0, hi = P->ncheckpoints - 1;
+  while (lo < hi) {
+    int mid = (lo + hi + 1) / 2;
+    if (P->checkpoints[mid] <= off) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+
+  int y = lo * PAGER_STRIDE;
+  off_t p = P->checkpoints[lo];
+  while (1) {
+    off_t next;
+    pagerLineAt(P, p, &next);
+    if (next > off || next >= P->size) return y;
+    p = next;
+    y++;
+  }
+}
+
+// Byte offset in the file of line `y`, or its size after the last line, which has no checkpoint
+// of its own when the line count is a multiple of `PAGER_STRIDE`
+long long editorPagerLineOffset(struct editorBuffer *B, int y) {
+  if (y >= B->numrows) return B->pager->size;
+  return pagerLineOffset(B->pager, y);
+}
+
+// Line holding byte `off` of the file
+int editorPagerLineAt(struct editorBuffer *B, long long off) {
+  struct editorPager *P = B->pager;
+  if (P->size == 0 || off < 0) return 0;
+  return pagerLineOfOffset(P, off);
+}
+
+// Finds `query` in the raw text, searching from byte column `from_cx` of line `from` onwards (or
+// from line `from` backwards) and wrapping around. Returns the line of the match, or -1, and its
+// byte column in `cx`.
+int editorPagerFind(struct editorBuffer *B, const char *query, int from, int from_cx, int direction,
+                    int *cx) {
+  struct editorPager *P = B->pager;
+  size_t qlen = strlen(query);
+  if (P->size == 0 || qlen == 0) return -1;
+
+  if (direction == 1) {
+    off_t start = from < B->numrows ? pagerLineOffset(P, from) + from_cx : 0;
+    if (start > P->size) start = P->size;
+    const char *m = memmem(P->data + start, P->size - start, query, qlen);
+    if (m == NULL) {
+      off_t wrap = start + (off_t)qlen - 1 < P->size ? start + (off_t)qlen - 1 : P->size;
+      m = memmem(P->data, wrap, query, qlen);
+    }
+    if (m == NULL) return -1;
+
+    int y = pagerLineOfOffset(P, m - P->data);
+    *cx = m - P->data - pagerLineOffset(P, y);
+    return y;
+  }
+
+  // Backwards, a line at a time; the first match within a line, as forwards
+  int y = from;
+  for (int i = 0; i < B->numrows; i++, y--) {
+    if (y < 0) y = B->numrows - 1;
+
+    off_t start = pagerLineOffset(P, y);
+    off_t next;
+    int len = pagerLineAt(P, start, &next);
+    const char *m = memmem(P->data + start, len, query, qlen);
+    if (m) {
+      *cx = m - P->data - start;
+      return y;
+    }
+  }
+  return -1;
+}
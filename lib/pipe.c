@@ -0,0 +1,143 @@
+/*** includes ***/
+
+// Feature test macros (portability): https://www.gnu.org/software/libc/manual/html_node/Feature-Test-Macros.html
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "editor.h"
+
+/*** pipe ***/
+
+// Reading a pipe, such as standard input for `editor -`, into a buffer as the data arrives. The
+// pipe is non-blocking and `editorPoll()` reads what is waiting, a bounded amount at a time, so
+// keys are never kept waiting and each batch of rows can be drawn as soon as it is in. The buffer
+// is read-only until the pipe is closed.
+
+#define PIPE_READ (1 << 20)        // Bytes asked for per `read()`
+#define PIPE_POLL_BYTES (4 << 20)  // Bytes turned into rows per poll on the main thread
+
+struct editorPipe {
+  int fd;
+  char *buf;
+  // A line still arriving. It becomes a row only once it is whole, so a long line is not
+  // rendered and highlighted again for every read.
+  char *line;
+  size_t line_len, line_cap;
+};
+
+// Adds `len` bytes to the line still arriving
+static void editorPipeCollect(struct editorPipe *P, const char *s, size_t len) {
+  if (P->line_len + len > P->line_cap) {
+    while (P->line_len + len > P->line_cap) P->line_cap = P->line_cap ? P->line_cap * 2 : 4096;
+    P->line = realloc(P->line, P->line_cap);
+  }
+  memcpy(&P->line[P->line_len], s, len);
+  P->line_len += len;
+}
+
+// Starts reading `fd` into the (empty) buffer. It is read as it becomes readable, and closed at
+// its end.
+void editorPipeOpen(struct editorBuffer *B, int fd) {
+  struct editorPipe *P = calloc(1, sizeof(struct editorPipe));
+  P->fd = fd;
+  P->buf = malloc(PIPE_READ);
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+#ifdef F_SETPIPE_SZ
+  fcntl(fd, F_SETPIPE_SZ, PIPE_READ);  // The writer gets further ahead between polls
+#endif
+
+  B->pipe = P;
+  B->journal.suspended++;  // Reading is not an edit
+}
+
+static void editorPipeClose(struct editorBuffer *B) {
+  struct editorPipe *P = B->pipe;
+  if (P->line_len > 0) editorInsertRow(B, B->numrows, P->line, P->line_len);  // Had no newline
+  close(P->fd);
+  free(P->buf);
+  free(P->line);
+  free(P);
+
+  B->pipe = NULL;
+  B->journal.suspended--;
+  B->dirty = 0;
+}
+
+// Splits `n` bytes read from the pipe into rows at the end of the buffer. Lines are counted first
+// so the row array grows once per read.
+static void editorPipeRows(struct editorBuffer *B, char *p, size_t n) {
+  struct editorPipe *P = B->pipe;
+  char *end = p + n;
+  char *nl;
+
+  int lines = 0;
+  for (char *q = p; (q = memchr(q, '\n', end - q)) != NULL; q++) lines++;
+  editorRowsReserve(B, B->numrows + lines + 1);
+
+  while (p < end) {
+    nl = memchr(p, '\n', end - p);
+    if (nl == NULL) {  // The rest of the line comes with a later read
+      editorPipeCollect(P, p, end - p);
+      break;
+    }
+
+    char *line = p;
+    size_t len = nl - p;
+    if (P->line_len > 0) {
+      editorPipeCollect(P, p, len);
+      line = P->line;
+      len = P->line_len;
+      P->line_len = 0;
+    }
+    while (len > 0 && line[len - 1] == '\r') len--;  // Even when the `\r\n` was split between reads
+    editorInsertRow(B, B->numrows, line, len);
+    p = nl + 1;
+  }
+}
+
+// Reads what the pipe has ready, up to `PIPE_POLL_BYTES`. Returns non-zero if rows were added or
+// the pipe was closed.
+int editorPipePoll(struct editorBuffer *B) {
+  struct editorPipe *P = B->pipe;
+  if (P == NULL) return 0;
+
+  TRACE_BEGIN("editorPipePoll");
+  int changed = 0;
+  for (int budget = PIPE_POLL_BYTES; budget > 0; budget -= PIPE_READ) {
+    ssize_t n = read(P->fd, P->buf, PIPE_READ);
+    if (n == -1 && errno == EINTR) continue;
+    if (n == -1 && errno == EAGAIN) break;
+    if (n <= 0) {  // The writer is done, or the pipe failed: keep what came through
+      editorPipeClose(B);
+      changed = 1;
+      break;
+    }
+
+    editorPipeRows(B, P->buf, n);
+    changed = 1;
+  }
+  if (B->pipe) B->dirty = 0;
+  TRACE_END("editorPipePoll");
+  return changed;
+}
+
+// Reads the rest of the pipe, waiting for it as need be
+void editorPipeFinish(struct editorBuffer *B) {
+  struct editorPipe *P = B->pipe;
+  if (P == NULL) return;
+
+  fcntl(P->fd, F_SETFL, fcntl(P->fd, F_GETFL) & ~O_NONBLOCK);
+  while (B->pipe) editorPipePoll(B);
+}
+
+// Stops reading, keeping the rows already read
+void editorPipeCancel(struct editorBuffer *B) {
+  if (B->pipe) editorPipeClose(B);
+}
@@ -0,0 +1,355 @@
+/*** includes ***/
+
+// Feature test macros (portability): https://www.gnu.org/software/libc/manual/html_node/Feature-Test-Macros.html
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "editor.h"
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+/*** pool ***/
+
+// Row storage shared by every buffer. Blocks are rounded up to a power-of-two size class, so
+// a row that grows by a few bytes usually stays in place. Small classes are carved out of 64 KiB
+// slabs, one class per slab, so loading a file costs one allocation per slab rather than three
+// per row; a freed block goes back on its slab's free list, and a slab is released once its
+// last block is freed. Slabs are mapped a region at a time and aligned to their size, so a block
+// finds its slab from its own address and carries only its class and size: 8 bytes a block. Heavy editing can leave many slabs mostly empty: compaction marks those
+// slabs, the caller moves every block it owns with `poolMove()`, and the emptied slabs go.
+// Blocks of larger classes are allocated one by one and kept on per-class free lists.
+
+struct poolSlab {
+  struct poolSlab *prev, *next;  // In its class's list
+  void *free;                    // Freed blocks, linked through their data
+  int cls;
+  int capacity;                  // Blocks that fit
+  int carved;                    // Blocks handed out at least once; the rest are untouched
+  int live;                      // Blocks in use
+  int evacuating;                // Being compacted: new blocks go elsewhere
+};
+
+struct poolBlock {
+  uint32_t cls;   // Size class index, or `EDITOR_POOL_CLASSES` for oversized blocks
+  uint32_t size;  // Bytes asked for; the capacity of an oversized block
+};
+
+#define POOL_HEADER sizeof(struct poolBlock)
+#define POOL_MIN_SHIFT 4           // Smallest class holds 16 bytes
+#define POOL_SLAB_SIZE (64 * 1024)
+#define POOL_SLAB_CLASSES 9        // Classes up to 4 KiB come from slabs
+#define POOL_SPARSE 2              // Compaction empties slabs less than 1/2 full
+#define POOL_REGION_SLABS 32       // Slabs mapped at a time
+
+static size_t poolClass(size_t size) {
+  size_t cls = 0;
+  while (cls < EDITOR_POOL_CLASSES && ((size_t)1 << (cls + POOL_MIN_SHIFT)) < size) cls++;
+  return cls;
+}
+
+static size_t poolCap(struct poolBlock *b) {
+  return b->cls < EDITOR_POOL_CLASSES ? (size_t)1 << (b->cls + POOL_MIN_SHIFT) : b->size;
+}
+
+void poolInit(struct editorPool *p, size_t limit) {
+  memset(p, 0, sizeof(*p));
+  p->limit = limit;
+}
+
+// The slab a block in a small class was carved from
+static struct poolSlab *poolBlockSlab(struct poolBlock *b) {
+  return (struct poolSlab *)((uintptr_t)b & ~(uintptr_t)(POOL_SLAB_SIZE - 1));
+}
+
+// Maps `POOL_REGION_SLABS` slabs, aligned by mapping one slab more and unmapping the excess
+static int poolRegionMap(struct editorPool *p) {
+  size_t len = (size_t)(POOL_REGION_SLABS + 1) * POOL_SLAB_SIZE;
+  char *map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (map == MAP_FAILED) return -1;
+
+  char *start = (char *)(((uintptr_t)map + POOL_SLAB_SIZE - 1) & ~(uintptr_t)(POOL_SLAB_SIZE - 1));
+  char *end = start + (size_t)POOL_REGION_SLABS * POOL_SLAB_SIZE;
+  if (start > map) munmap(map, start - map);
+  if (map + len > end) munmap(end, map + len - end);
+
+#ifdef MADV_POPULATE_WRITE
+  // A pool past its first region is being filled: faulting the next one in with one call is
+  // much cheaper than a fault per page
+  if (p->slab_bytes > 0) madvise(start, end - start, MADV_POPULATE_WRITE);
+#endif
+
+  p->region = start;
+  p->region_left = POOL_REGION_SLABS;
+  return 0;
+}
+
+// Unmaps the slabs of the current region that were never used
+static void poolRegionUnmap(struct editorPool *p) {
+  if (p->region_left > 0) munmap(p->region, (size_t)p->region_left * POOL_SLAB_SIZE);
+  p->region = NULL;
+  p->region_left = 0;
+}
+
+static struct poolSlab *poolSlabNew(struct editorPool *p, int cls) {
+  if (p->region_left == 0 && poolRegionMap(p) == -1) return NULL;
+  struct poolSlab *s = (struct poolSlab *)p->region;
+  p->region += POOL_SLAB_SIZE;
+  p->region_left--;
+
+  size_t cap = (size_t)1 << (cls + POOL_MIN_SHIFT);
+  memset(s, 0, sizeof(*s));
+  s->cls = cls;
+  s->capacity = (POOL_SLAB_SIZE - sizeof(*s)) / (POOL_HEADER + cap);
+
+  s->next = p->slabs[cls];
+  if (s->next) s->next->prev = s;
+  p->slabs[cls] = s;
+
+  p->slab_bytes += POOL_SLAB_SIZE;
+  p->cached += s->capacity * cap;
+  return s;
+}
+
+static void poolSlabRelease(struct editorPool *p, struct poolSlab *s) {
+  if (s->prev) {
+    s->prev->next = s->next;
+  } else {
+    p->slabs[s->cls] = s->next;
+  }
+  if (s->next) s->next->prev = s->prev;
+  if (p->current[s->cls] == s) p->current[s->cls] = NULL;
+
+  p->slab_bytes -= POOL_SLAB_SIZE;
+  p->cached -= s->capacity * ((size_t)1 << (s->cls + POOL_MIN_SHIFT));
+  munmap(s, POOL_SLAB_SIZE);
+}
+
+static int poolSlabHasRoom(struct poolSlab *s) {
+  return !s->evacuating && (s->free || s->carved < s->capacity);
+}
+
+static struct poolBlock *poolSlabAlloc(struct editorPool *p, int cls) {
+  struct poolSlab *s = p->current[cls];
+  if (s == NULL || !poolSlabHasRoom(s)) {
+    // Searching the slabs only when one may have room keeps a long load linear in its size
+    s = NULL;
+    if (!p->full[cls]) {
+      for (s = p->slabs[cls]; s && !poolSlabHasRoom(s); s = s->next) {}
+    }
+    if (s == NULL) p->full[cls] = 1;
+    if (s == NULL && (s = poolSlabNew(p, cls)) == NULL) return NULL;
+    p->current[cls] = s;
+  }
+
+  size_t cap = (size_t)1 << (cls + POOL_MIN_SHIFT);
+  struct poolBlock *b;
+  if (s->free) {
+    b = (struct poolBlock *)s->free - 1;
+    s->free = *(void **)s->free;
+  } else {
+    b = (struct poolBlock *)((char *)(s + 1) + s->carved++ * (POOL_HEADER + cap));
+    b->cls = cls;
+  }
+
+  s->live++;
+  p->cached -= cap;
+  return b;
+}
+
+void *poolAlloc(struct editorPool *p, size_t size) {
+  size_t cls = poolClass(size);
+  struct poolBlock *b;
+
+  if (cls < POOL_SLAB_CLASSES) {
+    b = poolSlabAlloc(p, cls);
+    if (b == NULL) return NULL;
+  } else if (cls < EDITOR_POOL_CLASSES && p->free[cls]) {
+    // A free block stores the next free block where its data would be
+    b = p->free[cls];
+    p->free[cls] = *(void **)(b + 1);
+    p->cached -= poolCap(b);
+  } else {
+    size_t cap = cls < EDITOR_POOL_CLASSES ? (size_t)1 << (cls + POOL_MIN_SHIFT) : size;
+    b = malloc(POOL_HEADER + cap);
+    if (b == NULL) return NULL;
+    b->cls = cls;
+    b->size = cap;
+    p->large_bytes += cap;
+  }
+
+  if (cls < EDITOR_POOL_CLASSES) b->size = size;
+  p->in_use += poolCap(b);
+  p->requested += b->size;
+  return b + 1;
+}
+
+void poolFree(struct editorPool *p, void *ptr) {
+  if (ptr == NULL) return;
+
+  struct poolBlock *b = (struct poolBlock *)ptr - 1;
+  size_t cap = poolCap(b);
+  p->in_use -= cap;
+  p->requested -= b->size;
+  p->freed += cap;
+
+  if (b->cls < POOL_SLAB_CLASSES) {
+    struct poolSlab *s = poolBlockSlab(b);
+    *(void **)ptr = s->free;
+    s->free = ptr;
+    s->live--;
+    p->cached += cap;
+    p->full[s->cls] = 0;
+    if (s->live == 0 && s != p->current[s->cls]) poolSlabRelease(p, s);
+    return;
+  }
+
+  if (b->cls == EDITOR_POOL_CLASSES) {
+    p->large_bytes -= cap;
+    free(b);
+    return;
+  }
+
+  *(void **)ptr = p->free[b->cls];
+  p->free[b->cls] = b;
+  p->cached += cap;
+}
+
+void *poolRealloc(struct editorPool *p, void *ptr, size_t size) {
+  if (ptr == NULL) return poolAlloc(p, size);
+
+  struct poolBlock *b = (struct poolBlock *)ptr - 1;
+  if (size <= poolCap(b)) {  // Still fits in the slack of its size class
+    if (b->cls < EDITOR_POOL_CLASSES) {
+      p->requested += size - b->size;
+      b->size = size;
+    }
+    return ptr;
+  }
+
+  void *new = poolAlloc(p, size);
+  if (new == NULL) return NULL;
+  memcpy(new, ptr, b->size);
+  poolFree(p, ptr);
+  return new;
+}
+
+// Returns cached free blocks and empty slabs to the system
+void poolTrim(struct editorPool *p) {
+  for (int cls = 0; cls < POOL_SLAB_CLASSES; cls++) {
+    struct poolSlab *s = p->current[cls];
+    if (s && s->live == 0) poolSlabRelease(p, s);
+  }
+  poolRegionUnmap(p);
+
+  for (int cls = POOL_SLAB_CLASSES; cls < EDITOR_POOL_CLASSES; cls++) {
+    while (p->free[cls]) {
+      struct poolBlock *b = p->free[cls];
+      p->free[cls] = *(void **)(b + 1);
+      p->cached -= poolCap(b);
+      p->large_bytes -= poolCap(b);
+      free(b);
+    }
+  }
+}
+
+// Moves everything `src` accounts for into `dst`, e.g. a thread's private pool once its rows
+// join a buffer. Blocks know their class and slab, so they can be freed into either pool
+// afterwards. Slabs the thread emptied again are released, as nothing is left to free into them.
+void poolMerge(struct editorPool *dst, struct editorPool *src) {
+  dst->in_use += src->in_use;
+  dst->cached += src->cached;
+  dst->requested += src->requested;
+  dst->slab_bytes += src->slab_bytes;
+  dst->large_bytes += src->large_bytes;
+  dst->freed += src->freed;
+
+  for (int cls = 0; cls < EDITOR_POOL_CLASSES; cls++) {
+    while (src->slabs[cls]) {
+      struct poolSlab *s = src->slabs[cls];
+      src->slabs[cls] = s->next;
+
+      s->prev = NULL;
+      s->next = dst->slabs[cls];
+      if (s->next) s->next->prev = s;
+      dst->slabs[cls] = s;
+      if (s->live == 0) poolSlabRelease(dst, s);
+    }
+    src->current[cls] = NULL;
+    dst->full[cls] = 0;
+
+    while (src->free[cls]) {
+      struct poolBlock *b = src->free[cls];
+      src->free[cls] = *(void **)(b + 1);
+      *(void **)(b + 1) = dst->free[cls];
+      dst->free[cls] = b;
+    }
+  }
+  poolRegionUnmap(src);
+  poolInit(src, src->limit);
+}
+
+// Starts a compaction if a quarter of the slab memory has been freed since the last one: slabs
+// less than half full are marked so that no new blocks go into them. Returns 0 if there is
+// nothing worth moving, otherwise the caller passes every block it owns through `poolMove()` and
+// then calls `poolCompactEnd()`.
+int poolCompactBegin(struct editorPool *p) {
+  if (p->freed < p->slab_bytes / 4) return 0;
+  p->freed = 0;
+
+  int marked = 0;
+  for (int cls = 0; cls < POOL_SLAB_CLASSES; cls++) {
+    for (struct poolSlab *s = p->slabs[cls]; s; s = s->next) {
+      if (s->live * POOL_SPARSE < s->capacity) {
+        s->evacuating = 1;
+        marked++;
+      }
+    }
+  }
+  return marked;
+}
+
+// Returns `ptr`, or a copy of it in a fuller slab if its own is being emptied
+void *poolMove(struct editorPool *p, void *ptr) {
+  if (ptr == NULL) return NULL;
+
+  struct poolBlock *b = (struct poolBlock *)ptr - 1;
+  if (b->cls >= POOL_SLAB_CLASSES || !poolBlockSlab(b)->evacuating) return ptr;
+
+  void *new = poolAlloc(p, b->size);
+  if (new == NULL) return ptr;
+  memcpy(new, ptr, b->size);
+  poolFree(p, ptr);
+  return new;
+}
+
+// Slabs still holding blocks nobody moved stay, and take new blocks again
+void poolCompactEnd(struct editorPool *p) {
+  for (int cls = 0; cls < POOL_SLAB_CLASSES; cls++) {
+    for (struct poolSlab *s = p->slabs[cls]; s; s = s->next) s->evacuating = 0;
+    p->full[cls] = 0;
+  }
+  p->freed = 0;  // Moving freed blocks too; that was not editing
+}
+
+void poolStats(struct editorPool *p, struct editorPoolStats *st) {
+  memset(st, 0, sizeof(*st));
+  st->slab_bytes = p->slab_bytes;
+  st->large_bytes = p->large_bytes;
+  st->in_use = p->in_use;
+  st->requested = p->requested;
+
+  for (int cls = 0; cls < POOL_SLAB_CLASSES; cls++) {
+    for (struct poolSlab *s = p->slabs[cls]; s; s = s->next) {
+      st->slabs++;
+      if (s->live) st->fragmented += (size_t)(s->capacity - s->live) << (cls + POOL_MIN_SHIFT);
+    }
+  }
+}
@@ -0,0 +1,375 @@
+/*** includes ***/
+
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "editor.h"
+
+/*** output ***/
+
+void editorScroll(struct editorWindow *W) {
+  struct editorBuffer *B = W->buf;
+
+  // Edits made through another window on the same buffer may have removed rows under this one
+  if (W->cy > B->numrows) W->cy = B->numrows;
+  W->rx = 0;
+
+  if (W->cy < B->numrows) {
+    erow *row = editorRow(B, W->cy);
+    if (W->cx > row->size) W->cx = row->size;
+    W->rx = editorRowCxToRx(row, W->cx);
+  }
+
+  if (W->cy < W->rowoff)
+    W->rowoff = W->cy;                  // Scroll up to cursor, if above visible window
+  if (W->cy >= W->rowoff + W->rows)     // Cursor is below window
+    W->rowoff = W->cy - W->rows + 1;
+  if (W->rx < W->coloff)
+    W->coloff = W->rx;
+  if (W->rx >= W->coloff + W->cols)
+    W->coloff = W->rx - W->cols + 1;
+}
+
+// Ends a window line: windows on the right edge erase to the end of the line, others pad to
+// their width so they never touch the window beside them
+static void editorEndLine(struct editorConfig *E, struct editorWindow *W, struct abuf *ab, int used) {
+  if (W->left + W->cols >= E->screencols) {
+    abAppend(ab, "\x1b[K", 3);  // Erase In Line (default 0: erase right of cursor)
+  } else {
+    while (used++ < W->cols) abAppend(ab, " ", 1);
+    abAppend(ab, "|", 1);  // Separator from the window to the right
+  }
+}
+
+static void editorMoveTo(struct abuf *ab, int row, int col) {
+  char buf[32];
+  int len = snprintf(buf, sizeof(buf), "\x1b[%d;%dH", row + 1, col + 1);
+  abAppend(ab, buf, len);
+}
+
+// Appends `len` rendered characters drawn in `style`, copying the stretches between control
+// characters in one go; control characters are shown in the same style inverted
+static void editorDrawText(struct abuf *ab, const char *c, int len, const struct editorStyle *style) {
+  struct editorStyle inverted = *style;
+  inverted.attrs ^= STYLE_INVERSE;
+
+  int from = 0;
+  for (int j = 0; j < len; j++) {
+    if (!iscntrl(c[j])) continue;
+
+    abAppend(ab, &c[from], j - from);
+    char sym = (c[j] <= 26) ? '@' + c[j] : '?';
+    editorStyleApply(ab, style, &inverted);
+    abAppend(ab, &sym, 1);
+    editorStyleApply(ab, &inverted, style);
+    from = j + 1;
+  }
+  abAppend(ab, &c[from], len - from);
+}
+
+// Whether `len` characters would look the same in any foreground colour
+static int editorBlank(const char *c, int len) {
+  for (int j = 0; j < len; j++) {
+    if (c[j] != ' ') return 0;
+  }
+  return 1;
+}
+
+// Draws the window's lines `from` to `to` (exclusive), counted from its top. The rendition carries
+// over from one line to the next, and is only reset where it would show.
+static void editorDrawLines(struct editorConfig *E, struct editorWindow *W, struct abuf *ab, int from,
+                            int to) {
+  struct editorBuffer *B = W->buf;
+  struct editorStyle current = editorStyleDefault;
+  int y;
+
+  editorMoveTo(ab, W->top + from, W->left);
+
+  for (y = from; y < to; y++) {
+    int filerow = y + W->rowoff;
+    int used = 0;
+
+    // Rows of a full-width window follow each other; others start at their own column
+    if (y > from) {
+      if (W->left == 0) {
+        abAppend(ab, "\r\n", 2);
+      } else {
+        editorMoveTo(ab, W->top + y, W->left);
+      }
+    }
+
+    if (filerow >= B->numrows) {
+      editorStyleApply(ab, &current, &editorStyleDefault);
+      current = editorStyleDefault;
+      if (B->numrows == 0 && y == W->rows / 3) {
+        char welcome[80];
+        int welcomelen = snprintf(welcome, sizeof(welcome), "Text editor -- version %s", EDITOR_VERSION);
+        if (welcomelen > W->cols) welcomelen = W->cols;
+        int padding = (W->cols - welcomelen) / 2;
+        used = padding + welcomelen;
+        if (padding) {
+          abAppend(ab, "~", 1);
+          padding--;
+        }
+        while (padding--) abAppend(ab, " ", 1);
+        abAppend(ab, welcome, welcomelen);
+      } else {
+        abAppend(ab, "~", 1);
+        used = 1;
+      }
+    } else {
+      erow *row = editorRow(B, filerow);
+      editorRowRestore(B, row);
+
+      int len = row->rsize - W->coloff;
+      if (len < 0) len = 0;
+      if (len > W->cols) len = W->cols;
+      used = len;
+
+      // The current search match, matched brackets and the selection are drawn over the row's
+      // own highlighting, in that order of precedence where they overlap
+      struct {
+        int start, end, hl;
+      } marks[4];
+      int nmarks = 0;
+      struct editorFind *f = &E->find;
+      struct editorBracketMatch *m = &E->brackets;
+      struct editorSelection *sel = &E->selection;
+      if (B == E->buf && f->match_len && f->match_line == filerow) {
+        marks[nmarks].start = f->match_rx;
+        marks[nmarks].end = f->match_rx + f->match_len;
+        marks[nmarks++].hl = HL_MATCH;
+      }
+      if (B == E->buf && m->shown && m->line == filerow) {
+        marks[nmarks].start = m->rx;
+        marks[nmarks].end = m->rx + 1;
+        marks[nmarks++].hl = HL_BRACKET;
+      }
+      if (B == E->buf && m->shown && m->match_line == filerow) {
+        marks[nmarks].start = m->match_rx;
+        marks[nmarks].end = m->match_rx + 1;
+        marks[nmarks++].hl = HL_BRACKET;
+      }
+      if (B == E->buf && sel->shown && filerow >= sel->y0 && filerow <= sel->y1) {
+        marks[nmarks].start = filerow == sel->y0 ? editorRowCxToRx(row, sel->x0) : 0;
+        marks[nmarks].end = filerow == sel->y1 ? editorRowCxToRx(row, sel->x1) : row->rsize;
+        marks[nmarks++].hl = HL_SELECTION;
+      }
+
+      // One copy per run of columns that share a class, and a change of rendition only where it
+      // would show
+      int s = 0;  // First span that may still reach `col`
+      int col = W->coloff;
+      while (col < W->coloff + len) {
+        int end = W->coloff + len;
+        int hl = HL_NORMAL;
+
+        while (s < row->nhl && row->hl[s].start + row->hl[s].len <= col) s++;
+        if (s < row->nhl && row->hl[s].start <= col) {
+          hl = row->hl[s].hl;
+          if (end > row->hl[s].start + row->hl[s].len) end = row->hl[s].start + row->hl[s].len;
+        } else if (s < row->nhl && end > row->hl[s].start) {
+          end = row->hl[s].start;
+        }
+
+        for (int k = 0; k < nmarks; k++) {
+          if (col >= marks[k].start && col < marks[k].end) {
+            hl = marks[k].hl;
+            if (end > marks[k].end) end = marks[k].end;
+            break;
+          }
+          if (col < marks[k].start && end > marks[k].start) end = marks[k].start;
+        }
+
+        struct editorStyle style = E->theme->styles[hl];
+        if (editorBlank(&row->render[col], end - col)) {  // E.g. indentation between two comments
+          style.fg = current.fg;
+          style.attrs = (style.attrs & ~STYLE_BOLD) | (current.attrs & STYLE_BOLD);
+        }
+        editorStyleApply(ab, &current, &style);
+        current = style;
+        editorDrawText(ab, &row->render[col], end - col, &current);
+        col = end;
+      }
+    }
+
+    // Erasing to the end of the line paints the background; padding and the separator are text
+    struct editorStyle rest = editorStyleDefault;
+    if (W->left + W->cols >= E->screencols) {
+      rest.fg = current.fg;
+      rest.attrs = current.attrs & STYLE_BOLD;
+    }
+    editorStyleApply(ab, &current, &rest);
+    current = rest;
+    editorEndLine(E, W, ab, used);
+  }
+
+  editorStyleApply(ab, &current, &editorStyleDefault);
+}
+
+// Records what the terminal now shows for `W`
+static void editorDrawn(struct editorWindow *W) {
+  W->drawn = 1;
+  W->drawn_buf = W->buf;
+  W->drawn_version = W->buf->version;
+  W->drawn_rowoff = W->rowoff;
+  W->drawn_coloff = W->coloff;
+}
+
+void editorDrawRows(struct editorConfig *E, struct editorWindow *W, struct abuf *ab) {
+  editorDrawLines(E, W, ab, 0, W->rows);
+  editorDrawn(W);
+}
+
+// A window whose rows only moved up or down since it was drawn. If it spans the screen, the
+// terminal shifts what it shows inside a scroll region (DECSTBM, then SU or SD) and only the rows
+// scrolled into view are sent. Returns 0 if the window has to be drawn in full.
+static int editorDrawScrolled(struct editorConfig *E, struct editorWindow *W, struct abuf *ab) {
+  int n = W->rowoff - W->drawn_rowoff;  // Positive when the text moves up
+  if (!W->drawn || W->drawn_buf != W->buf || W->drawn_version != W->buf->version ||
+      W->drawn_coloff != W->coloff || n == 0 || n >= W->rows || -n >= W->rows ||
+      W->left != 0 || W->cols < E->screencols) {
+    return 0;
+  }
+
+  char buf[32];
+  int len = snprintf(buf, sizeof(buf), "\x1b[%d;%dr", W->top + 1, W->top + W->rows);
+  abAppend(ab, buf, len);
+  len = snprintf(buf, sizeof(buf), n > 0 ? "\x1b[%dS" : "\x1b[%dT", n > 0 ? n : -n);
+  abAppend(ab, buf, len);
+  abAppend(ab, "\x1b[r", 3);  // Back to the whole screen
+
+  if (n > 0) {
+    editorDrawLines(E, W, ab, W->rows - n, W->rows);
+  } else {
+    editorDrawLines(E, W, ab, 0, -n);
+  }
+  editorDrawn(W);
+  return 1;
+}
+
+// Status line under a window that doesn't reach the bottom of the screen
+void editorDrawWindowStatus(struct editorConfig *E, struct editorWindow *W, struct abuf *ab) {
+  struct editorBuffer *B = W->buf;
+  char status[80];
+
+  int len = snprintf(
+      status,
+      sizeof(status),
+      "%s%.20s%s %d/%d",
+      W == E->win ? "> " : "",
+      B->filename ? B->filename : "[No Name]",
+      B->dirty ? " (modified)" : "",
+      W->cy + 1,
+      B->numrows);
+  if (len > W->cols) len = W->cols;
+
+  editorMoveTo(ab, W->top + W->rows, W->left);
+  abAppend(ab, "\x1b[7m", 4);
+  abAppend(ab, status, len);
+  for (int used = len; used < W->cols; used++) abAppend(ab, " ", 1);
+  abAppend(ab, "\x1b[m", 3);
+  editorEndLine(E, W, ab, W->cols);
+}
+
+void editorDrawStatusBar(struct editorConfig *E, struct abuf *ab) {
+  struct editorBuffer *B = E->buf;
+  editorMoveTo(ab, E->screenrows, 0);
+  // Select Graphic Rendition (0: none [default], 1: bold, 4: underscore, 5: blink, 7: inverted colors)
+  abAppend(ab, "\x1b[7m", 4);
+
+  char status[80], rstatus[80], bufnum[32] = "", loading[32] = "";
+
+  if (E->numbuffers > 1) snprintf(bufnum, sizeof(bufnum), "[%d/%d] ", E->current + 1, E->numbuffers);
+  if (B->loader) snprintf(loading, sizeof(loading), " (loading %d%%)", editorLoaderProgress(B));
+  if (B->pipe) snprintf(loading, sizeof(loading), " (reading)");
+  if (B->follow) snprintf(loading, sizeof(loading), " (following)");
+
+  int len = snprintf(
+      status,
+      sizeof(status),
+      "%s%.20s - %d lines%s%s",
+      bufnum,
+      B->filename ? B->filename : "[No Name]",
+      B->numrows,
+      loading,
+      B->dirty ? " (modified)" : "");
+
+  int rlen = snprintf(
+      rstatus,
+      sizeof(rstatus),
+      "%s | %d/%d",
+      B->syntax ? B->syntax->filetype : "no filetype",
+      B->cy + 1,
+      B->numrows);
+
+  if (len > E->screencols) len = E->screencols;
+  abAppend(ab, status, len);
+
+  while (len < E->screencols) {
+    if (E->screencols - len == rlen) {
+      abAppend(ab, rstatus, rlen);
+      break;
+    } else {
+      abAppend(ab, " ", 1);
+      len++;
+    }
+  }
+  abAppend(ab, "\x1b[m", 3);
+  abAppend(ab, "\r\n", 2);
+}
+
+void editorDrawMessageBar(struct editorConfig *E, struct abuf *ab) {
+  abAppend(ab, "\x1b[K", 3);  // Clear rest of line
+  int msglen = strlen(E->statusmsg);
+  if (msglen > E->screencols) msglen = E->screencols;
+  if (msglen && time(NULL) - E->statusmsg_time < 5) abAppend(ab, E->statusmsg, msglen);
+}
+
+// Composes a frame (windows, status bar, message bar and cursor position) into `ab`. Windows
+// whose buffer, version and scroll offsets match what they last drew are left untouched, and
+// windows that only scrolled vertically redraw just the rows that came into view.
+void editorRenderScreen(struct editorConfig *E, struct abuf *ab) {
+  struct editorWindow *wins[EDITOR_MAX_WINDOWS];
+  int n = editorWindowsCollect(E->layout, wins, EDITOR_MAX_WINDOWS);
+
+  if (E->relayout) editorWindowsLayout(E);
+
+  // Every window scrolls on its own view; the active one's lives in the buffer meanwhile
+  editorWindowStore(E->win);
+  for (int j = 0; j < n; j++) editorScroll(wins[j]);
+  editorWindowLoad(E->win);
+  editorBracketsUpdate(E);
+  editorSelectionUpdate(E);
+
+  // Escape sequences always start with `\x1b` (27) followed by `[`
+  abAppend(ab, "\x1b[?25l", 6);  // Reset Mode/turn off (25: cursor on/off, l: off)
+
+  for (int j = 0; j < n; j++) {
+    struct editorWindow *W = wins[j];
+    if (!W->drawn || W->drawn_buf != W->buf || W->drawn_version != W->buf->version ||
+        W->drawn_rowoff != W->rowoff || W->drawn_coloff != W->coloff) {
+      if (!editorDrawScrolled(E, W, ab)) editorDrawRows(E, W, ab);
+    }
+    if (W->statusline) editorDrawWindowStatus(E, W, ab);
+  }
+
+  editorDrawStatusBar(E, ab);
+  editorDrawMessageBar(E, ab);
+
+  struct editorWindow *W = E->win;
+  editorMoveTo(ab, W->top + W->cy - W->rowoff, W->left + W->rx - W->coloff);  // Account for scrolling
+
+  abAppend(ab, "\x1b[?25h", 6);  // Set Mode/turn on (25: cursor on/off, h: on)
+}
+
+void editorSetStatusMessage(struct editorConfig *E, const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(E->statusmsg, sizeof(E->statusmsg), fmt, ap);
+  va_end(ap);
+  E->statusmsg_time = time(NULL);  // Current time (seconds since 1970-01-01)
+}
@@ -0,0 +1,201 @@
+/*** includes ***/
+
+// Feature test macros (portability): https://www.gnu.org/software/libc/manual/html_node/Feature-Test-Macros.html
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <regex.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "editor.h"
+
+/*** replace ***/
+
+// Replacing every match in one pass over the rows. Each row's matches are found first, then the
+// row is rebuilt in a single allocation of its new size, so the cost is linear in the text and
+// the number of replacements. The rows are highlighted as the pass goes, and below the last
+// changed row only for as long as their comment state changes. The journal records the
+// replacement itself, not the rows it touched.
+
+#define REPLACE_GROUPS 10  // `\0` (the whole match) to `\9`
+
+struct replaceMatch {
+  int start, end;
+  regmatch_t groups[REPLACE_GROUPS];
+};
+
+struct replaceState {
+  const char *pattern;
+  size_t patlen;
+  const char *with;
+  size_t withlen;
+  regex_t re;
+  int regex;
+  struct replaceMatch *matches;  // Matches in the current row
+  int nmatches, cap;
+};
+
+// Length of the replacement for `m` in `chars`, and its text in `out` if not NULL. In regex mode
+// `\0` to `\9` stand for the match and its groups, and `\\` for a backslash.
+static size_t replaceExpand(struct replaceState *R, const char *chars, struct replaceMatch *m, char *out) {
+  if (!R->regex) {
+    if (out) memcpy(out, R->with, R->withlen);
+    return R->withlen;
+  }
+
+  size_t len = 0;
+  for (size_t j = 0; j < R->withlen; j++) {
+    char c = R->with[j];
+    if (c == '\\' && j + 1 < R->withlen && R->with[j + 1] >= '0' && R->with[j + 1] <= '9') {
+      regmatch_t *g = &m->groups[R->with[++j] - '0'];
+      if (g->rm_so == -1) continue;  // A group that took no part in the match
+      if (out) memcpy(&out[len], &chars[g->rm_so], g->rm_eo - g->rm_so);
+      len += g->rm_eo - g->rm_so;
+      continue;
+    }
+    if (c == '\\' && j + 1 < R->withlen && R->with[j + 1] == '\\') j++;
+    if (out) out[len] = c;
+    len++;
+  }
+  return len;
+}
+
+// `memmem()`, with candidates found by `memchr()` on the first byte, which costs far less per
+// call on the short rows of a typical file
+static char *replaceSearch(const char *s, size_t len, const char *pattern, size_t patlen) {
+  const char *end = s + len;
+  while ((size_t)(end - s) >= patlen && (s = memchr(s, pattern[0], end - s - patlen + 1)) != NULL) {
+    if (!memcmp(s, pattern, patlen)) return (char *)s;
+    s++;
+  }
+  return NULL;
+}
+
+// Finds the matches in `row` into `R->matches`. Returns how many there are.
+static int replaceFind(struct replaceState *R, erow *row) {
+  R->nmatches = 0;
+  int at = 0;
+
+  while (at <= row->size) {
+    struct replaceMatch m;
+
+    if (R->regex) {
+      // Matching resumes mid-row, where `^` must not match again
+      if (regexec(&R->re, &row->chars[at], REPLACE_GROUPS, m.groups, at > 0 ? REG_NOTBOL : 0) != 0) break;
+      for (int g = 0; g < REPLACE_GROUPS; g++) {
+        if (m.groups[g].rm_so == -1) continue;
+        m.groups[g].rm_so += at;
+        m.groups[g].rm_eo += at;
+      }
+      m.start = m.groups[0].rm_so;
+      m.end = m.groups[0].rm_eo;
+    } else {
+      char *found = replaceSearch(&row->chars[at], row->size - at, R->pattern, R->patlen);
+      if (found == NULL) break;
+      m.start = found - row->chars;
+      m.end = m.start + R->patlen;
+    }
+
+    if (R->nmatches == R->cap) {
+      R->cap = R->cap ? R->cap * 2 : 16;
+      R->matches = realloc(R->matches, sizeof(struct replaceMatch) * R->cap);
+    }
+    R->matches[R->nmatches++] = m;
+
+    // An empty match replaces nothing; the next search starts a character on
+    at = m.end > m.start ? m.end : m.end + 1;
+  }
+  return R->nmatches;
+}
+
+// Rebuilds `row` with its matches replaced, in one new allocation
+static void replaceRow(struct editorBuffer *B, struct replaceState *R, erow *row) {
+  size_t len = row->size;
+  for (int k = 0; k < R->nmatches; k++) {
+    struct replaceMatch *m = &R->matches[k];
+    len += replaceExpand(R, row->chars, m, NULL) - (m->end - m->start);
+  }
+
+  char *chars = poolAlloc(B->pool, len + 1);
+  size_t to = 0;
+  int from = 0;
+  for (int k = 0; k < R->nmatches; k++) {
+    struct replaceMatch *m = &R->matches[k];
+    memcpy(&chars[to], &row->chars[from], m->start - from);
+    to += m->start - from;
+    to += replaceExpand(R, row->chars, m, &chars[to]);
+    from = m->end;
+  }
+  memcpy(&chars[to], &row->chars[from], row->size - from);
+  chars[len] = '\0';
+
+  poolFree(B->pool, row->chars);
+  row->chars = chars;
+  row->size = len;
+}
+
+// Replaces every match of `pattern` in `B` with `with`: literal text, or with `regex` set, a POSIX
+// extended regular expression matched within rows. Returns the number of replacements, or -1 with
+// a message in `err` if the expression does not compile.
+int editorReplaceAll(struct editorBuffer *B, const char *pattern, const char *with, int regex, char *err,
+                     size_t errlen) {
+  if (editorBufferReadOnly(B) || pattern[0] == '\0') return 0;
+
+  struct replaceState R = {.pattern = pattern, .patlen = strlen(pattern), .with = with, .withlen = strlen(with),
+                           .regex = regex};
+  if (regex) {
+    int rc = regcomp(&R.re, pattern, REG_EXTENDED);
+    if (rc != 0) {
+      regerror(rc, &R.re, err, errlen);
+      return -1;
+    }
+  }
+
+  TRACE_BEGIN("editorReplaceAll");
+  editorHighlighterFinish(B);
+
+  int replaced = 0;
+  int first = -1;
+  int in_comment = 0;
+  int highlighted_with = 0;  // The state row `y` was last highlighted with: its old predecessor's
+
+  for (int y = 0; y < B->numrows; y++) {
+    erow *row = &B->row[y];
+    int n = replaceFind(&R, row);
+    int old_open = row->hl_open_comment;
+
+    if (n > 0) {
+      editorClipboardTouch(B, y);
+      replaceRow(B, &R, row);
+      replaced += n;
+      if (first == -1) first = y;
+    }
+
+    // Other rows below a change are highlighted again only if they now start in another state.
+    // A plain buffer's row that was never rendered stays that way until something reads it.
+    int lazy = B->plain && row->render == NULL;
+    if (!lazy && (n > 0 || (first != -1 && in_comment != highlighted_with))) {
+      editorRenderRow(B->pool, row);
+      in_comment = editorHighlightRow(B->pool, B->syntax, row, in_comment);
+      row->hl_open_comment = in_comment;
+    } else {
+      in_comment = row->hl_open_comment;
+    }
+    highlighted_with = old_open;
+  }
+
+  if (regex) regfree(&R.re);
+  free(R.matches);
+
+  if (replaced > 0) {
+    editorBracketsInvalidate(B);
+    editorLinesChanged(B, first);
+    B->dirty++;
+    B->version++;
+    editorJournalReplace(B, pattern, with, regex);
+  }
+  TRACE_END("editorReplaceAll");
+  return replaced;
+}
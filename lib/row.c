@@ -0,0 +1,404 @@
+/*** includes ***/
+
+// Feature test macros (portability): https://www.gnu.org/software/libc/manual/html_node/Feature-Test-Macros.html
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "editor.h"
+
+/*** row operations ***/
+
+int editorRowCxToRx(erow *row, int cx) {
+  int rx = 0;
+  for (int j = 0; j < cx; j++) {
+    if (row->chars[j] == '\t') rx += (EDITOR_TAB_STOP - 1) - (rx % EDITOR_TAB_STOP);
+    rx++;
+  }
+
+  return rx;
+}
+
+int editorRowRxToCx(erow *row, int rx) {
+  int cur_rx = 0;
+  int cx;
+
+  for (cx = 0; cx < row->size; cx++) {
+    if (row->chars[cx] == '\t') cur_rx += (EDITOR_TAB_STOP - 1) - (cur_rx % EDITOR_TAB_STOP);
+    cur_rx++;
+    if (cur_rx > rx) return cx;
+  }
+  return cx;
+}
+
+// Expands tabs from `chars` into `render`, allocating from `pool`
+void editorRenderRow(struct editorPool *pool, erow *row) {
+  int tabs = 0;
+
+  int j;
+  for (j = 0; j < row->size; j++) {
+    if (row->chars[j] == '\t') tabs++;  // Count tabs to calculate memory to allocate for `render`
+  }
+
+  // Without tabs the text renders as itself; most rows of most files need no copy
+  if (row->shared) row->render = NULL;  // `chars` may have moved since
+  if (tabs == 0) {
+    poolFree(pool, row->render);
+    row->render = row->chars;
+    row->rsize = row->size;
+    row->shared = 1;
+    return;
+  }
+  row->shared = 0;
+
+  // `row->size` already counts 1 per tab; multiply tab count by 7 and add to get maximum row memory
+  row->render = poolRealloc(pool, row->render, row->size + tabs * (EDITOR_TAB_STOP - 1) + 1);
+
+  int idx = 0;
+  for (j = 0; j < row->size; j++) {
+    if (row->chars[j] == '\t') {
+      row->render[idx++] = ' ';
+      // Append spaces until we reach a tab stop (column divisible by 8)
+      while (idx % EDITOR_TAB_STOP != 0) row->render[idx++] = ' ';
+    } else {
+      row->render[idx++] = row->chars[j];
+    }
+  }
+
+  row->render[idx] = '\0';
+  row->rsize = idx;
+}
+
+void editorUpdateRow(struct editorBuffer *B, erow *row) {
+  TRACE_BEGIN("editorUpdateRow");
+  editorRenderRow(B->pool, row);
+  editorUpdateSyntax(B, row);
+  TRACE_END("editorUpdateRow");
+}
+
+// Rebuilds `render` and `hl` for a row of an evicted buffer. The row's `hl_open_comment` survives
+// eviction, so highlighting it again never has to revisit the rows above.
+void editorRowRestore(struct editorBuffer *B, erow *row) {
+  if (row->render == NULL) {
+    editorHighlighterFinish(B);
+    editorUpdateRow(B, row);
+  }
+}
+
+// Makes room for `n` rows, so that appending up to that many reallocates nothing
+void editorRowsReserve(struct editorBuffer *B, int n) {
+  if (n <= B->rowcap) return;
+  // Geometric growth keeps appends amortized O(1)
+  while (B->rowcap < n) B->rowcap = B->rowcap ? B->rowcap * 2 : 16;
+  B->row = realloc(B->row, sizeof(erow) * B->rowcap);
+}
+
+// Renders and highlights rows `at` to `at + n - 1` in one pass, carrying the comment state from
+// row to row, then the rows below for as long as their state changes
+static void editorRowsUpdate(struct editorBuffer *B, int at, int n) {
+  int in_comment = (at > 0 && B->row[at - 1].hl_open_comment);
+
+  for (int y = at; y < at + n; y++) {
+    erow *row = &B->row[y];
+    editorRenderRow(B->pool, row);
+    in_comment = editorHighlightRow(B->pool, B->syntax, row, in_comment);
+    row->hl_open_comment = in_comment;
+  }
+  editorBracketsInvalidate(B);
+  B->version++;
+
+  if (at + n < B->numrows) editorUpdateSyntax(B, &B->row[at + n]);
+}
+
+void editorInsertRow(struct editorBuffer *B, int at, char *s, size_t len) {
+  if (at < 0 || at > B->numrows) return;
+  editorHighlighterFinish(B);  // Its threads read the rows
+  editorClipboardTouch(B, at);
+  editorBracketsInvalidate(B);
+
+  if (B->numrows == B->rowcap) editorRowsReserve(B, B->numrows + 1);
+  memmove(&B->row[at + 1], &B->row[at], sizeof(erow) * (B->numrows - at));
+
+  for (int j = at + 1; j <= B->numrows; j++) B->row[j].idx++;
+
+  B->row[at].idx = at;
+
+  B->row[at].size = len;
+  B->row[at].chars = poolAlloc(B->pool, len + 1);
+  memcpy(B->row[at].chars, s, len);
+  B->row[at].chars[len] = '\0';
+
+  B->row[at].rsize = 0;
+  B->row[at].render = NULL;
+  B->row[at].shared = 0;
+  B->row[at].hl = NULL;
+  B->row[at].nhl = 0;
+  B->row[at].hl_open_comment = 0;
+
+  editorUpdateRow(B, &B->row[at]);
+
+  B->numrows++;
+  B->dirty++;
+  editorLinesChanged(B, at);
+  editorJournalInsertRow(B, at, s, len);
+}
+
+// Inserts `n` rows at `at` holding copies of the text of the rows `src`, moving the rows below
+// once. `src` may only point into `B->row` above `at`, after room was reserved for the new rows.
+void editorInsertRows(struct editorBuffer *B, int at, erow *src, int n) {
+  if (at < 0 || at > B->numrows || n <= 0) return;
+  editorHighlighterFinish(B);
+  editorClipboardTouch(B, at);
+
+  editorRowsReserve(B, B->numrows + n);
+  memmove(&B->row[at + n], &B->row[at], sizeof(erow) * (B->numrows - at));
+  for (int j = at + n; j < B->numrows + n; j++) B->row[j].idx += n;
+
+  for (int k = 0; k < n; k++) {
+    erow *row = &B->row[at + k];
+    memset(row, 0, sizeof(erow));
+    row->idx = at + k;
+    row->size = src[k].size;
+    row->chars = poolAlloc(B->pool, src[k].size + 1);
+    memcpy(row->chars, src[k].chars, src[k].size);
+    row->chars[row->size] = '\0';
+  }
+  B->numrows += n;
+
+  editorRowsUpdate(B, at, n);
+  B->dirty++;
+  editorLinesChanged(B, at);
+  editorJournalInsertRows(B, at, &B->row[at], n);
+}
+
+void editorFreeRow(struct editorBuffer *B, erow *row) {
+  if (!row->shared) poolFree(B->pool, row->render);
+  poolFree(B->pool, row->chars);
+  poolFree(B->pool, row->hl);
+}
+
+void editorDelRow(struct editorBuffer *B, int at) {
+  if (at < 0 || at >= B->numrows) return;
+  editorHighlighterFinish(B);
+  editorClipboardTouch(B, at);
+  editorBracketsInvalidate(B);
+  editorFreeRow(B, &B->row[at]);
+  memmove(&B->row[at], &B->row[at + 1], sizeof(erow) * (B->numrows - at - 1));
+
+  for (int j = at; j < B->numrows - 1; j++) B->row[j].idx--;
+
+  B->numrows--;
+  B->dirty++;
+  B->version++;
+  editorLinesChanged(B, at);
+  editorJournalDelRow(B, at);
+}
+
+// Deletes rows `at` to `at + n - 1`, moving the rows below once. With `out`, the rows go there
+// with their text rather than being freed; only their render and highlight caches are dropped.
+void editorDelRows(struct editorBuffer *B, int at, int n, erow *out) {
+  if (at < 0 || n <= 0 || at + n > B->numrows) return;
+  editorHighlighterFinish(B);
+  editorClipboardTouch(B, at);
+
+  for (int k = 0; k < n; k++) {
+    erow *row = &B->row[at + k];
+    if (out == NULL) {
+      editorFreeRow(B, row);
+      continue;
+    }
+    if (!row->shared) poolFree(B->pool, row->render);
+    poolFree(B->pool, row->hl);
+    out[k] = *row;
+    out[k].idx = k;
+    out[k].render = NULL;
+    out[k].rsize = 0;
+    out[k].shared = 0;
+    out[k].hl = NULL;
+    out[k].nhl = 0;
+  }
+  memmove(&B->row[at], &B->row[at + n], sizeof(erow) * (B->numrows - at - n));
+  for (int j = at; j < B->numrows - n; j++) B->row[j].idx -= n;
+  B->numrows -= n;
+
+  editorRowsUpdate(B, at, 0);  // The row now at `at` may no longer start inside a comment
+  B->dirty++;
+  editorLinesChanged(B, at);
+  editorJournalDelRows(B, at, n);
+}
+
+void editorRowInsertChar(struct editorBuffer *B, erow *row, int at, int c) {
+  editorHighlighterFinish(B);
+  editorClipboardTouch(B, row->idx);
+  if (at < 0 || at > row->size) at = row->size;
+  row->chars = poolRealloc(B->pool, row->chars, row->size + 2);
+  memmove(&row->chars[at + 1], &row->chars[at], row->size - at + 1);
+  row->size++;
+  row->chars[at] = c;
+  editorUpdateRow(B, row);
+  B->dirty++;
+  editorLinesChanged(B, row->idx);
+  editorJournalInsertChar(B, row->idx, at, c);
+}
+
+// Inserts `len` bytes of `s` before column `at`, or at the end of the row
+void editorRowInsertString(struct editorBuffer *B, erow *row, int at, const char *s, size_t len) {
+  if (len == 0) return;
+  editorHighlighterFinish(B);
+  editorClipboardTouch(B, row->idx);
+  if (at < 0 || at > row->size) at = row->size;
+  row->chars = poolRealloc(B->pool, row->chars, row->size + len + 1);
+  memmove(&row->chars[at + len], &row->chars[at], row->size - at + 1);
+  memcpy(&row->chars[at], s, len);
+  row->size += len;
+  editorUpdateRow(B, row);
+  B->dirty++;
+  editorLinesChanged(B, row->idx);
+  editorJournalInsert(B, row->idx, at, s, len);
+}
+
+void editorRowAppendString(struct editorBuffer *B, erow *row, char *s, size_t len) {
+  editorHighlighterFinish(B);
+  editorClipboardTouch(B, row->idx);
+  row->chars = poolRealloc(B->pool, row->chars, row->size + len + 1);
+  memcpy(&row->chars[row->size], s, len);
+  row->size += len;
+  row->chars[row->size] = '\0';
+  editorUpdateRow(B, row);
+  B->dirty++;
+  editorLinesChanged(B, row->idx);
+  editorJournalAppend(B, row->idx, s, len);
+}
+
+void editorRowDelChar(struct editorBuffer *B, erow *row, int at) {
+  if (at < 0 || at >= row->size) return;
+  editorHighlighterFinish(B);
+  editorClipboardTouch(B, row->idx);
+  memmove(&row->chars[at], &row->chars[at + 1], row->size - at);
+  row->size--;
+  editorUpdateRow(B, row);
+  B->dirty++;
+  editorLinesChanged(B, row->idx);
+  editorJournalDelChar(B, row->idx, at);
+}
+
+// Deletes `len` characters from column `at`
+void editorRowDelChars(struct editorBuffer *B, erow *row, int at, int len) {
+  if (at < 0 || at >= row->size || len <= 0) return;
+  if (len > row->size - at) len = row->size - at;
+  editorHighlighterFinish(B);
+  editorClipboardTouch(B, row->idx);
+  memmove(&row->chars[at], &row->chars[at + len], row->size - at - len + 1);
+  row->size -= len;
+  editorUpdateRow(B, row);
+  B->dirty++;
+  editorLinesChanged(B, row->idx);
+  editorJournalDelChars(B, row->idx, at, len);
+}
+
+void editorRowTruncate(struct editorBuffer *B, erow *row, int size) {
+  if (size < 0 || size >= row->size) return;
+  editorHighlighterFinish(B);
+  editorClipboardTouch(B, row->idx);
+  row->size = size;
+  row->chars[row->size] = '\0';
+  editorUpdateRow(B, row);
+  B->dirty++;
+  editorLinesChanged(B, row->idx);
+  editorJournalTruncate(B, row->idx, size);
+}
+
+// Leading characters that unindenting `row` removes: a tab, or spaces up to the first tab stop
+int editorRowIndentWidth(erow *row) {
+  if (row->size > 0 && row->chars[0] == '\t') return 1;
+
+  int w = 0;
+  while (w < row->size && w < EDITOR_TAB_STOP && row->chars[w] == ' ') w++;
+  return w;
+}
+
+// Indents rows `at` to `at + n - 1` by a tab, or with a negative `dir` unindents them, then
+// highlights them in one pass. Blank rows are not indented.
+void editorIndentRows(struct editorBuffer *B, int at, int n, int dir) {
+  if (at < 0 || n <= 0 || at + n > B->numrows) return;
+  editorHighlighterFinish(B);
+  editorClipboardTouch(B, at);
+
+  for (int y = at; y < at + n; y++) {
+    erow *row = &B->row[y];
+    if (dir > 0 && row->size > 0) {
+      row->chars = poolRealloc(B->pool, row->chars, row->size + 2);
+      memmove(&row->chars[1], row->chars, row->size + 1);
+      row->chars[0] = '\t';
+      row->size++;
+    } else if (dir < 0) {
+      int w = editorRowIndentWidth(row);
+      memmove(row->chars, &row->chars[w], row->size - w + 1);
+      row->size -= w;
+    }
+  }
+
+  editorRowsUpdate(B, at, n);
+  B->dirty++;
+  editorLinesChanged(B, at);
+  editorJournalIndent(B, at, n, dir);
+}
+
+// Row `y` of `B`. A pager's rows are built on demand and stay valid only until the next few are.
+erow *editorRow(struct editorBuffer *B, int y) {
+  if (B->pager) return editorPagerRow(B, y);
+  return &B->row[y];
+}
+
+/*** editor operations ***/
+
+// Buffers are read-only while they load, follow their file or read a pipe, since rows are being
+// appended to them, while a compressed save reads their rows, and as pagers, which have no rows
+// to edit
+int editorBufferReadOnly(struct editorBuffer *B) {
+  return B->loader || B->pipe || B->saver || B->follow || B->pager;
+}
+
+void editorInsertChar(struct editorBuffer *B, int c) {
+  if (editorBufferReadOnly(B)) return;
+  if (B->cy == B->numrows) {  // On a tilde line; must append a row before inserting
+    editorInsertRow(B, B->numrows, "", 0);
+  }
+  editorRowInsertChar(B, &B->row[B->cy], B->cx, c);
+  B->cx++;
+}
+
+void editorInsertNewline(struct editorBuffer *B) {
+  if (editorBufferReadOnly(B)) return;
+  if (B->cx == 0) {
+    editorInsertRow(B, B->cy, "", 0);
+  } else {
+    erow *row = &B->row[B->cy];
+    editorInsertRow(B, B->cy + 1, &row->chars[B->cx], row->size - B->cx);
+    editorRowTruncate(B, &B->row[B->cy], B->cx);
+  }
+
+  B->cy++;
+  B->cx = 0;
+}
+
+void editorDelChar(struct editorBuffer *B) {
+  if (editorBufferReadOnly(B)) return;
+  if (B->cy == B->numrows) return;
+  if (B->cx == 0 && B->cy == 0) return;
+
+  erow *row = &B->row[B->cy];
+
+  if (B->cx > 0) {
+    editorRowDelChar(B, row, B->cx - 1);
+    B->cx--;
+  } else {
+    B->cx = B->row[B->cy - 1].size;
+    editorRowAppendString(B, &B->row[B->cy - 1], row->chars, row->size);
+    editorDelRow(B, B->cy);
+    B->cy--;
+  }
+}
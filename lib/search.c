@@ -0,0 +1,116 @@
+/*** includes ***/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "editor.h"
+
+/*** find ***/
+
+void editorFindCallback(struct editorConfig *E, char *query, int key) {
+  struct editorBuffer *B = E->buf;
+  struct editorFind *f = &E->find;
+
+  TRACE_BEGIN("editorFindCallback");
+
+  if (f->match_len) {
+    f->match_len = 0;
+    B->version++;
+  }
+
+  // Return immediately if user pressed Esc or Enter to leave search mode
+  if (key == '\r' || key == '\x1b') {
+    f->last_match = -1;
+    f->direction = 1;
+    f->typing = 0;
+    TRACE_END("editorFindCallback");
+    return;
+  } else if (key == ARROW_RIGHT || key == ARROW_DOWN) {
+    f->direction = 1;
+  } else if (key == ARROW_LEFT || key == ARROW_UP) {
+    f->direction = -1;
+  } else {
+    f->last_match = -1;
+    f->direction = 1;
+  }
+
+  if (f->last_match == -1) f->direction = 1;
+  int current = f->last_match;
+
+  // A new search starts just after the cursor, so searching again (or replaying a macro that
+  // searches) moves on to the next match. Typing more of the query then searches from the match
+  // itself, so it keeps to the same match while it still fits.
+  int from = 0;     // Rendered column of the first row searched
+  int from_cx = 0;  // The same in bytes, for a pager
+  if (current == -1 && B->cy < B->numrows) {
+    current = B->cy - 1;
+    from_cx = B->cx + !f->typing;
+    from = editorRowCxToRx(editorRow(B, B->cy), B->cx) + !f->typing;
+  }
+  if (key != ARROW_RIGHT && key != ARROW_DOWN && key != ARROW_LEFT && key != ARROW_UP) f->typing = 1;
+
+  // A pager searches the mapped file itself rather than materialising every row
+  if (B->pager) {
+    int cx;
+    int y = current + f->direction;
+    if (y < 0) y = B->numrows - 1;
+    if (y >= B->numrows) y = 0;
+
+    current = editorPagerFind(B, query, y, from_cx, f->direction, &cx);
+    // A macro's search stops at the end of the file here too, rather than wrapping around
+    int wrapped = current != -1 &&
+                  (f->direction == 1 ? current < y || (current == y && cx < from_cx) : current > y);
+    if (E->macro.playing && wrapped) current = -1;
+    if (current != -1) {
+      erow *row = editorRow(B, current);
+      f->last_match = current;
+      B->cy = current;
+      B->cx = cx;
+      B->rowoff = B->numrows;
+
+      f->match_line = current;
+      f->match_rx = editorRowCxToRx(row, cx);
+      f->match_len = strlen(query);
+      B->version++;
+    } else {
+      f->misses++;
+    }
+    TRACE_END("editorFindCallback");
+    return;
+  }
+
+  // Coming back round to the cursor's row, the part before the cursor is searched too
+  int found = 0;
+  for (int i = 0; i < B->numrows + (from > 0); i++) {
+    current += f->direction;
+
+    // Cycle from bottom of file to top, or vice versa. A macro's search stops at the end instead,
+    // so a replay repeated until a search fails ends there.
+    if (current == -1 || current == B->numrows) {
+      if (E->macro.playing) break;
+      current = current == -1 ? B->numrows - 1 : 0;
+    }
+
+    erow *row = &B->row[current];
+    editorRowRestore(B, row);
+    int start = i > 0 ? 0 : from < row->rsize ? from : row->rsize;
+    char *match = strstr(&row->render[start], query);
+
+    if (match) {
+      f->last_match = current;
+      B->cy = current;
+      B->cx = editorRowRxToCx(row, match - row->render);
+      B->rowoff = B->numrows;
+
+      f->match_line = current;
+      f->match_rx = match - row->render;
+      f->match_len = strlen(query);
+      B->version++;
+      found = 1;
+      break;
+    }
+  }
+  if (!found) f->misses++;
+
+  TRACE_END("editorFindCallback");
+}
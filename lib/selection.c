@@ -0,0 +1,278 @@
+/*** includes ***/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "editor.h"
+
+/*** selection ***/
+
+// A region is selected by setting the mark and moving the cursor. Cutting, copying, pasting and
+// indenting a region are each one operation on a range of rows, with one highlighting pass over
+// them, however many rows it spans.
+
+// Sets the mark at the cursor of the current buffer
+void editorSelectionStart(struct editorConfig *E) {
+  struct editorSelection *S = &E->selection;
+  editorSelectionClear(E);
+  S->buf = E->buf;
+  S->cx = E->buf->cx;
+  S->cy = E->buf->cy;
+}
+
+void editorSelectionClear(struct editorConfig *E) {
+  struct editorSelection *S = &E->selection;
+  if (S->shown && S->buf) S->buf->version++;
+  S->buf = NULL;
+  S->shown = 0;
+}
+
+// The selected region of the current buffer, from column `x0` of row `y0` to before column `x1`
+// of row `y1`. Returns 0 if nothing is selected.
+int editorSelectionBounds(struct editorConfig *E, int *y0, int *x0, int *y1, int *x1) {
+  struct editorSelection *S = &E->selection;
+  struct editorBuffer *B = E->buf;
+  if (S->buf != B || B->numrows == 0) return 0;
+
+  int ay = S->cy, ax = S->cx, by = B->cy, bx = B->cx;
+  if (ay > by || (ay == by && ax > bx)) {
+    ay = B->cy, ax = B->cx;
+    by = S->cy, bx = S->cx;
+  }
+
+  // Rows may have gone since the mark was set; the line after the last row ends the last row
+  if (ay >= B->numrows) return 0;
+  if (by >= B->numrows) {
+    by = B->numrows - 1;
+    bx = editorRow(B, by)->size;
+  }
+  int asize = editorRow(B, ay)->size;
+  if (ax > asize) ax = asize;
+  int bsize = editorRow(B, by)->size;
+  if (bx > bsize) bx = bsize;
+  if (ay == by && ax == bx) return 0;
+
+  *y0 = ay;
+  *x0 = ax;
+  *y1 = by;
+  *x1 = bx;
+  return 1;
+}
+
+// Has the current buffer repainted if the selected region differs from the one on screen
+void editorSelectionUpdate(struct editorConfig *E) {
+  struct editorSelection *S = &E->selection;
+  int y0 = 0, x0 = 0, y1 = 0, x1 = 0;
+  int shown = editorSelectionBounds(E, &y0, &x0, &y1, &x1);
+
+  if (shown != S->shown || (shown && (y0 != S->y0 || x0 != S->x0 || y1 != S->y1 || x1 != S->x1))) {
+    E->buf->version++;
+    S->shown = shown;
+    S->y0 = y0;
+    S->x0 = x0;
+    S->y1 = y1;
+    S->x1 = x1;
+  }
+}
+
+// Moves the selected region to the clipboard. The rows wholly inside it move there as they are;
+// only the parts of its first and last rows are copied. Returns the lines cut, or -1 if nothing
+// is selected.
+int editorSelectionCut(struct editorConfig *E) {
+  struct editorBuffer *B = E->buf;
+  int y0, x0, y1, x1;
+  if (editorBufferReadOnly(B) || !editorSelectionBounds(E, &y0, &x0, &y1, &x1)) return -1;
+  editorSelectionClear(E);
+  editorClipboardClear(E);
+
+  struct editorClipboard *C = &E->clipboard;
+  C->numrows = y1 - y0 + 1;
+  C->rows = malloc(sizeof(erow) * C->numrows);
+
+  erow *first = &B->row[y0];
+  int len = (y0 == y1 ? x1 : first->size) - x0;
+  memset(&C->rows[0], 0, sizeof(erow));
+  C->rows[0].size = len;
+  C->rows[0].chars = poolAlloc(B->pool, len + 1);
+  memcpy(C->rows[0].chars, &first->chars[x0], len);
+  C->rows[0].chars[len] = '\0';
+
+  if (y0 == y1) {
+    editorRowDelChars(B, first, x0, len);
+  } else {
+    // The first row keeps what precedes the region and takes what follows it on the last row
+    erow *last = &B->row[y1];
+    editorRowTruncate(B, first, x0);
+    editorRowInsertString(B, first, x0, &last->chars[x1], last->size - x1);
+    editorDelRows(B, y0 + 1, y1 - y0, &C->rows[1]);
+
+    last = &C->rows[C->numrows - 1];
+    last->size = x1;
+    last->chars[x1] = '\0';
+  }
+
+  B->cy = y0;
+  B->cx = x0;
+  editorSetStatusMessage(E, "Cut %d line%s", C->numrows, C->numrows == 1 ? "" : "s");
+  return C->numrows;
+}
+
+// Puts the selected region on the clipboard, by reference to its rows. Returns the lines copied,
+// or -1 if nothing is selected.
+int editorSelectionCopy(struct editorConfig *E) {
+  struct editorBuffer *B = E->buf;
+  int y0, x0, y1, x1;
+  if (!editorSelectionBounds(E, &y0, &x0, &y1, &x1)) return -1;
+  editorSelectionClear(E);
+  editorClipboardClear(E);
+
+  struct editorClipboard *C = &E->clipboard;
+  C->numrows = y1 - y0 + 1;
+  C->src = B;
+  C->y0 = y0;
+  C->x0 = x0;
+  C->y1 = y1;
+  C->x1 = x1;
+  B->clipboard = C;
+  if (B->pager) editorClipboardTouch(B, y0);  // Its rows are rebuilt as others are read
+
+  editorSetStatusMessage(E, "Copied %d line%s", C->numrows, C->numrows == 1 ? "" : "s");
+  return C->numrows;
+}
+
+// Indents (`dir` > 0) or unindents the rows of the selected region, or the cursor's row if
+// nothing is selected. A region ending at the start of a row leaves that row alone. The
+// selection stays, so the rows can be shifted again. Returns the rows changed.
+int editorSelectionIndent(struct editorConfig *E, int dir) {
+  struct editorBuffer *B = E->buf;
+  struct editorSelection *S = &E->selection;
+  if (editorBufferReadOnly(B)) return 0;
+
+  int y0 = 0, x0 = 0, y1 = 0, x1 = 0;
+  if (!editorSelectionBounds(E, &y0, &x0, &y1, &x1)) {
+    if (B->cy >= B->numrows) return 0;
+    y0 = y1 = B->cy;
+  }
+  if (y1 > y0 && x1 == 0) y1--;
+
+  // The cursor and the mark stay on the same text
+  int *cursors[2][2] = {{&B->cx, &B->cy}, {&S->cx, &S->cy}};
+  int shift[2] = {0, 0};
+  for (int j = 0; j < 2; j++) {
+    int y = *cursors[j][1];
+    if (y < y0 || y > y1) continue;
+    erow *row = &B->row[y];
+    shift[j] = dir > 0 ? (row->size > 0 && *cursors[j][0] > 0) : -editorRowIndentWidth(row);
+  }
+
+  editorIndentRows(B, y0, y1 - y0 + 1, dir);
+
+  for (int j = 0; j < 2; j++) {
+    *cursors[j][0] += shift[j];
+    if (*cursors[j][0] < 0) *cursors[j][0] = 0;
+  }
+  return y1 - y0 + 1;
+}
+
+/*** clipboard ***/
+
+// Line `k` of the clipboard
+static void clipboardLine(struct editorClipboard *C, int k, char **s, int *len) {
+  if (C->src == NULL) {
+    *s = C->rows[k].chars;
+    *len = C->rows[k].size;
+    return;
+  }
+
+  erow *row = editorRow(C->src, C->y0 + k);
+  int start = k == 0 ? C->x0 : 0;
+  int end = k == C->numrows - 1 ? C->x1 : row->size;
+  *s = &row->chars[start];
+  *len = end - start;
+}
+
+// Row `y` of `B` is about to change, or rows are about to be inserted or deleted there. If the
+// clipboard refers to that row or those below it, it copies its text out first.
+void editorClipboardTouch(struct editorBuffer *B, int y) {
+  struct editorClipboard *C = B->clipboard;
+  if (C == NULL || y > C->y1) return;
+  TRACE_BEGIN("editorClipboardTouch");
+
+  erow *rows = malloc(sizeof(erow) * C->numrows);
+  for (int k = 0; k < C->numrows; k++) {
+    char *s;
+    int len;
+    clipboardLine(C, k, &s, &len);
+
+    memset(&rows[k], 0, sizeof(erow));
+    rows[k].idx = k;
+    rows[k].size = len;
+    rows[k].chars = poolAlloc(B->pool, len + 1);
+    memcpy(rows[k].chars, s, len);
+    rows[k].chars[len] = '\0';
+  }
+
+  C->rows = rows;
+  C->src = NULL;
+  B->clipboard = NULL;
+  TRACE_END("editorClipboardTouch");
+}
+
+void editorClipboardClear(struct editorConfig *E) {
+  struct editorClipboard *C = &E->clipboard;
+
+  if (C->src) {
+    C->src->clipboard = NULL;
+  } else {
+    for (int k = 0; k < C->numrows; k++) poolFree(&E->pool, C->rows[k].chars);
+    free(C->rows);
+  }
+  memset(C, 0, sizeof(*C));
+}
+
+// Inserts the clipboard at the cursor, leaving the cursor after it: its first line goes into the
+// cursor's row, the lines between become rows inserted in one go, and its last line starts the
+// row that takes the rest of the cursor's. Returns the lines pasted, or -1 if there are none.
+int editorClipboardPaste(struct editorConfig *E) {
+  struct editorBuffer *B = E->buf;
+  struct editorClipboard *C = &E->clipboard;
+  if (editorBufferReadOnly(B) || C->numrows == 0) return -1;
+  editorSelectionClear(E);
+
+  // Pasting into or above the rows it refers to would move them from under it
+  editorClipboardTouch(B, B->cy);
+  if (B->cy == B->numrows) editorInsertRow(B, B->numrows, "", 0);
+  editorRowsReserve(B, B->numrows + C->numrows);  // Referred rows above the cursor stay put
+
+  int n = C->numrows;
+  char *s;
+  int len;
+  erow *row = &B->row[B->cy];
+
+  if (n == 1) {
+    clipboardLine(C, 0, &s, &len);
+    editorRowInsertString(B, row, B->cx, s, len);
+    B->cx += len;
+    return n;
+  }
+
+  // The last line followed by the rest of the cursor's row
+  char *last;
+  int lastlen;
+  clipboardLine(C, n - 1, &last, &lastlen);
+  int restlen = row->size - B->cx;
+  char *joined = malloc(lastlen + restlen + 1);
+  memcpy(joined, last, lastlen);
+  memcpy(&joined[lastlen], &row->chars[B->cx], restlen);
+
+  clipboardLine(C, 0, &s, &len);
+  editorRowTruncate(B, row, B->cx);
+  editorRowInsertString(B, row, B->cx, s, len);
+  editorInsertRows(B, B->cy + 1, (C->src ? &C->src->row[C->y0] : C->rows) + 1, n - 2);
+  editorInsertRow(B, B->cy + n - 1, joined, lastlen + restlen);
+  free(joined);
+
+  B->cy += n - 1;
+  B->cx = lastlen;
+  return n;
+}
@@ -0,0 +1,376 @@
+/*** includes ***/
+
+// Feature test macros (portability): https://www.gnu.org/software/libc/manual/html_node/Feature-Test-Macros.html
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "editor.h"
+
+/*** filetypes ***/
+
+char *C_HL_extensions[] = {".c", ".h", ".cpp", NULL};
+
+// Secondary keywords end in |
+char *C_HL_keywords[] = {
+    "switch", "if", "while", "for", "break", "continue", "return", "else",
+    "struct", "union", "typedef", "static", "enum", "class", "case",
+    "int|", "long|", "double|", "float|", "char|", "unsigned|", "signed|",
+    "void|", NULL};
+
+/* Highlight database */
+struct editorSyntax HLDB[] = {
+    {
+        "c",
+        C_HL_extensions,
+        C_HL_keywords,
+        "//",
+        "/*",
+        "*/",
+        HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS,
+        NULL,
+        NULL,
+    }};
+
+#define HLDB_ENTRIES (sizeof(HLDB) / sizeof(HLDB[0]))
+
+/*** syntax files ***/
+
+// Filetypes loaded by `editorSyntaxLoad()`; they are matched before the built-in ones
+static struct editorSyntax **loaded;
+static int nloaded;
+
+// Appends a copy of `word` (followed by `suffix`) to the NULL-terminated `*list` of `*n` words
+static void syntaxListAppend(char ***list, int *n, const char *word, const char *suffix) {
+  *list = realloc(*list, sizeof(char *) * (*n + 2));
+  (*list)[*n] = malloc(strlen(word) + strlen(suffix) + 1);
+  strcpy((*list)[*n], word);
+  strcat((*list)[*n], suffix);
+  (*list)[++*n] = NULL;
+}
+
+static void syntaxFree(struct editorSyntax *s) {
+  for (int j = 0; s->filematch && s->filematch[j]; j++) free(s->filematch[j]);
+  for (int j = 0; s->keywords && s->keywords[j]; j++) free(s->keywords[j]);
+  free(s->filematch);
+  free(s->keywords);
+  free(s->filetype);
+  free(s->singleline_comment_start);
+  free(s->multiline_comment_start);
+  free(s->multiline_comment_end);
+  free(s->quotes);
+  editorLexerFree(s->lexer);
+  free(s);
+}
+
+// Reads a definition such as `syntax/python.syntax`: a directive and its words per line.
+//
+//     filetype python
+//     match .py .pyw SConstruct  (extensions, or text the file name contains)
+//     keywords if else while     (highlighted as keywords; repeat the line to add more)
+//     types int str              (highlighted as types)
+//     comment #                  (single-line comment)
+//     block /* */                (multi-line comment)
+//     strings "'                 (quote characters)
+//     numbers
+//     ignorecase                 (keywords match in any case)
+//
+// Lines starting with `#` are comments. Returns NULL with the reason in `err`.
+static struct editorSyntax *syntaxParse(FILE *fp, char *err, size_t errlen) {
+  struct editorSyntax *s = calloc(1, sizeof(struct editorSyntax));
+  int nmatch = 0, nkeywords = 0;
+  s->keywords = calloc(1, sizeof(char *));  // A filetype may have no keywords at all
+
+  char *line = NULL;
+  size_t cap = 0;
+  int lineno = 0;
+  err[0] = '\0';
+  while (getline(&line, &cap, fp) != -1 && err[0] == '\0') {
+    lineno++;
+    if (line[0] == '#') continue;
+
+    char *save;
+    char *directive = strtok_r(line, " \t\r\n", &save);
+    if (directive == NULL) continue;
+    char *arg = strtok_r(NULL, " \t\r\n", &save);
+
+    if (!strcmp(directive, "match") || !strcmp(directive, "keywords") || !strcmp(directive, "types")) {
+      for (; arg; arg = strtok_r(NULL, " \t\r\n", &save)) {
+        if (directive[0] == 'm') {
+          syntaxListAppend(&s->filematch, &nmatch, arg, "");
+        } else {
+          syntaxListAppend(&s->keywords, &nkeywords, arg, directive[0] == 't' ? "|" : "");
+        }
+      }
+    } else if (!strcmp(directive, "numbers") || !strcmp(directive, "ignorecase")) {
+      s->flags |= directive[0] == 'n' ? HL_HIGHLIGHT_NUMBERS : HL_IGNORE_CASE;
+    } else if (arg == NULL) {
+      snprintf(err, errlen, "line %d: %.20s needs an argument", lineno, directive);
+    } else if (!strcmp(directive, "filetype")) {
+      free(s->filetype);
+      s->filetype = strdup(arg);
+    } else if (!strcmp(directive, "comment")) {
+      free(s->singleline_comment_start);
+      s->singleline_comment_start = strdup(arg);
+    } else if (!strcmp(directive, "strings")) {
+      free(s->quotes);
+      s->quotes = strdup(arg);
+      s->flags |= HL_HIGHLIGHT_STRINGS;
+    } else if (!strcmp(directive, "block")) {
+      char *end = strtok_r(NULL, " \t\r\n", &save);
+      if (end == NULL) {
+        snprintf(err, errlen, "line %d: block needs a start and an end", lineno);
+      } else {
+        free(s->multiline_comment_start);
+        free(s->multiline_comment_end);
+        s->multiline_comment_start = strdup(arg);
+        s->multiline_comment_end = strdup(end);
+      }
+    } else {
+      snprintf(err, errlen, "line %d: unknown directive %.20s", lineno, directive);
+    }
+  }
+  free(line);
+
+  if (err[0] == '\0' && (s->filetype == NULL || s->filematch == NULL)) {
+    snprintf(err, errlen, "needs a filetype and a match line");
+  }
+  if (err[0]) {
+    syntaxFree(s);
+    return NULL;
+  }
+  return s;
+}
+
+// Loads one definition, compiling it unless its cached lexer is still current
+static int syntaxLoadFile(const char *path, char *err, size_t errlen) {
+  FILE *fp = fopen(path, "r");
+  struct stat st;
+  if (fp == NULL || fstat(fileno(fp), &st) == -1) {
+    snprintf(err, errlen, "%s", strerror(errno));
+    if (fp) fclose(fp);
+    return -1;
+  }
+
+  struct editorSyntax *s = syntaxParse(fp, err, errlen);
+  fclose(fp);
+  if (s == NULL) return -1;
+
+  s->lexer = editorLexerLoad(path, &st);
+  if (s->lexer == NULL) {
+    s->lexer = editorLexerCompile(s, err, errlen);
+    if (s->lexer == NULL) {
+      syntaxFree(s);
+      return -1;
+    }
+    editorLexerSave(path, &st, s->lexer);
+  }
+
+  loaded = realloc(loaded, sizeof(struct editorSyntax *) * (nloaded + 1));
+  loaded[nloaded++] = s;
+  return 0;
+}
+
+static int syntaxFileFilter(const struct dirent *d) {
+  const char *dot = strrchr(d->d_name, '.');
+  return d->d_name[0] != '.' && dot && !strcmp(dot, ".syntax");
+}
+
+// Loads every `*.syntax` file in `dir`, in name order, for the filetypes they describe. Returns 0,
+// or -1 with the first problem in `err`; the other files still load. A missing directory is not
+// a problem. Not thread-safe: call it before opening files.
+int editorSyntaxLoad(const char *dir, char *err, size_t errlen) {
+  struct dirent **names;
+  int n = scandir(dir, &names, syntaxFileFilter, alphasort);
+  if (n == -1) return 0;
+
+  int ret = 0;
+  for (int j = 0; j < n; j++) {
+    char *path = malloc(strlen(dir) + strlen(names[j]->d_name) + 2);
+    sprintf(path, "%s/%s", dir, names[j]->d_name);
+
+    char why[80];
+    if (syntaxLoadFile(path, why, sizeof(why)) == -1 && ret == 0) {
+      snprintf(err, errlen, "%s: %s", names[j]->d_name, why);
+      ret = -1;
+    }
+    free(path);
+    free(names[j]);
+  }
+  free(names);
+  return ret;
+}
+
+/*** syntax highlighting ***/
+
+int is_separator(int c) {
+  return isspace(c) || c == '\0' || strchr(",.()+-/*=~%<>[];", c) != NULL;
+}
+
+// Marks `len` columns from `start` as `hl`. Marks come in column order and never overlap, so one
+// either extends the last span or starts a new one after it.
+static void editorSpanMark(struct editorPool *pool, erow *row, int start, int len, int hl) {
+  struct editorSpan *last = row->nhl ? &row->hl[row->nhl - 1] : NULL;
+  if (last && last->hl == hl && last->start + last->len == start && last->len + len <= EDITOR_SPAN_MAX) {
+    last->len += len;
+    return;
+  }
+
+  while (len > 0) {
+    int n = len < EDITOR_SPAN_MAX ? len : EDITOR_SPAN_MAX;
+    row->hl = poolRealloc(pool, row->hl, sizeof(struct editorSpan) * (row->nhl + 1));
+    row->hl[row->nhl].start = start;
+    row->hl[row->nhl].len = n;
+    row->hl[row->nhl].hl = hl;
+    row->nhl++;
+    start += n;
+    len -= n;
+  }
+}
+
+// Cuts the spans back to end at column `at`, so the columns after it can be marked again
+static void editorSpanTruncate(erow *row, int at) {
+  while (row->nhl && row->hl[row->nhl - 1].start + row->hl[row->nhl - 1].len > at) {
+    struct editorSpan *last = &row->hl[row->nhl - 1];
+    if (last->start < at) {
+      last->len = at - last->start;
+      return;
+    }
+    row->nhl--;
+  }
+}
+
+// Highlights `row->render` into spans in `row->hl`, allocated from `pool`, starting inside a
+// multi-line comment if `in_comment` is set. Returns whether the row ends inside one. Touches
+// nothing but the row and `pool`, so rows can be highlighted on any thread with its own pool.
+int editorHighlightRow(struct editorPool *pool, struct editorSyntax *syntax, erow *row, int in_comment) {
+  row->nhl = 0;
+
+  if (syntax == NULL) {
+    poolFree(pool, row->hl);
+    row->hl = NULL;
+    editorBracketsCount(row);
+    return 0;
+  }
+
+  struct editorLexer *X = syntax->lexer;
+  const struct editorLexMove *moves = X->moves;
+  int nclasses = X->nclasses;
+  int state = in_comment ? X->comment : 0;
+
+  // Runs of one highlight are marked when they end
+  int run = 0;
+  int run_hl = HL_NORMAL;
+  for (int i = 0; i < row->rsize; i++) {
+    const struct editorLexMove *m = &moves[state * nclasses + X->classes[(unsigned char)row->render[i]]];
+    int hl = m->hl & 0xf;
+
+    if (m->back) {
+      if (run_hl != HL_NORMAL) editorSpanMark(pool, row, run, i - run, run_hl);
+      editorSpanTruncate(row, i - m->back);
+      editorSpanMark(pool, row, i - m->back, m->back, m->hl >> 4);
+      run = i;
+      run_hl = hl;
+    } else if (hl != run_hl) {
+      if (run_hl != HL_NORMAL) editorSpanMark(pool, row, run, i - run, run_hl);
+      run = i;
+      run_hl = hl;
+    }
+    state = m->next;
+  }
+  if (run_hl != HL_NORMAL) editorSpanMark(pool, row, run, row->rsize - run, run_hl);
+
+  // The end of the row can finish a keyword
+  const struct editorLexMove *m = &moves[state * nclasses + nclasses - 1];
+  if (m->back) {
+    editorSpanTruncate(row, row->rsize - m->back);
+    editorSpanMark(pool, row, row->rsize - m->back, m->back, m->hl >> 4);
+  }
+
+  if (row->nhl == 0) {  // Plain rows hold no spans at all
+    poolFree(pool, row->hl);
+    row->hl = NULL;
+  }
+  editorBracketsCount(row);
+  return X->open[state];
+}
+
+void editorUpdateSyntax(struct editorBuffer *B, erow *row) {
+  if (row->render == NULL) {
+    editorUpdateRow(B, row);  // Evicted row: rebuilding `render` highlights it too
+    return;
+  }
+
+  B->version++;
+
+  if (B->syntax == NULL) {
+    editorHighlightRow(B->pool, NULL, row, 0);
+    editorBracketsChanged(B, row->idx);
+    return;
+  }
+
+  TRACE_BEGIN("editorUpdateSyntax");
+  int in_comment = (row->idx > 0 && B->row[row->idx - 1].hl_open_comment);
+  in_comment = editorHighlightRow(B->pool, B->syntax, row, in_comment);
+
+  int changed = (row->hl_open_comment != in_comment);
+  row->hl_open_comment = in_comment;
+  editorBracketsChanged(B, row->idx);
+  TRACE_END("editorUpdateSyntax");
+
+  if (changed && row->idx + 1 < B->numrows) editorUpdateSyntax(B, &B->row[row->idx + 1]);
+}
+
+static int editorSyntaxMatches(struct editorSyntax *s, const char *name, const char *ext) {
+  for (unsigned int i = 0; s->filematch[i]; i++) {
+    int is_ext = (s->filematch[i][0] == '.');
+
+    // `strcmp()` returns 0 if strings are equal
+    if ((is_ext && ext && !strcmp(ext, s->filematch[i])) ||
+        (!is_ext && strstr(name, s->filematch[i]))) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+void editorSelectSyntaxHighlight(struct editorBuffer *B) {
+  editorHighlighterCancel(B);
+  B->syntax = NULL;
+
+  if (B->filename == NULL || B->plain) return;
+
+  // `file.c.gz` is highlighted as `file.c`
+  char name[256];
+  snprintf(name, sizeof(name), "%s", B->filename);
+  if (editorCompressionForName(name) != COMPRESS_NONE) *strrchr(name, '.') = '\0';
+
+  char *ext = strrchr(name, '.');  // Pointer to last occurrence in string
+
+  struct editorSyntax *s = NULL;
+  for (int j = 0; j < nloaded && s == NULL; j++) {
+    if (editorSyntaxMatches(loaded[j], name, ext)) s = loaded[j];
+  }
+  for (unsigned int j = 0; j < HLDB_ENTRIES && s == NULL; j++) {
+    if (editorSyntaxMatches(&HLDB[j], name, ext)) s = &HLDB[j];
+  }
+
+  if (s && s->lexer == NULL) {  // A built-in filetype, compiled on first use
+    char err[80];
+    s->lexer = editorLexerCompile(s, err, sizeof(err));
+    if (s->lexer == NULL) s = NULL;
+  }
+
+  B->syntax = s;
+  if (B->pager) return;  // Its rows are highlighted as they are read
+
+  editorHighlighterStart(B);
+}
@@ -0,0 +1,123 @@
+/*** includes ***/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "editor.h"
+
+/*** theme ***/
+
+// How each highlight class is drawn. `basic` uses the eight ANSI colours every terminal has;
+// the others need a 256-colour or a 24-bit colour terminal.
+static const struct editorTheme themes[] = {
+    {"basic",
+     {
+         [HL_NORMAL] = {EDITOR_COLOR_DEFAULT, EDITOR_COLOR_DEFAULT, 0},
+         [HL_COMMENT] = {6, EDITOR_COLOR_DEFAULT, 0},  // Cyan
+         [HL_MLCOMMENT] = {6, EDITOR_COLOR_DEFAULT, 0},
+         [HL_KEYWORD1] = {3, EDITOR_COLOR_DEFAULT, 0},  // Yellow
+         [HL_KEYWORD2] = {2, EDITOR_COLOR_DEFAULT, 0},  // Green
+         [HL_STRING] = {5, EDITOR_COLOR_DEFAULT, 0},    // Magenta
+         [HL_NUMBER] = {1, EDITOR_COLOR_DEFAULT, 0},    // Red
+         [HL_MATCH] = {4, EDITOR_COLOR_DEFAULT, 0},     // Blue
+         [HL_BRACKET] = {EDITOR_COLOR_DEFAULT, EDITOR_COLOR_DEFAULT, STYLE_INVERSE},
+         [HL_SELECTION] = {7, 4, 0},  // White on blue
+     }},
+    {"256",
+     {
+         [HL_NORMAL] = {EDITOR_COLOR_DEFAULT, EDITOR_COLOR_DEFAULT, 0},
+         [HL_COMMENT] = {8, EDITOR_COLOR_DEFAULT, 0},
+         [HL_MLCOMMENT] = {8, EDITOR_COLOR_DEFAULT, 0},
+         [HL_KEYWORD1] = {208, EDITOR_COLOR_DEFAULT, 0},
+         [HL_KEYWORD2] = {75, EDITOR_COLOR_DEFAULT, 0},
+         [HL_STRING] = {114, EDITOR_COLOR_DEFAULT, 0},
+         [HL_NUMBER] = {141, EDITOR_COLOR_DEFAULT, 0},
+         [HL_MATCH] = {16, 220, STYLE_BOLD},
+         [HL_BRACKET] = {EDITOR_COLOR_DEFAULT, 239, STYLE_BOLD},
+         [HL_SELECTION] = {EDITOR_COLOR_DEFAULT, 24, 0},
+     }},
+    {"truecolor",
+     {
+         [HL_NORMAL] = {EDITOR_COLOR_DEFAULT, EDITOR_COLOR_DEFAULT, 0},
+         [HL_COMMENT] = {EDITOR_RGB(106, 153, 85), EDITOR_COLOR_DEFAULT, 0},
+         [HL_MLCOMMENT] = {EDITOR_RGB(106, 153, 85), EDITOR_COLOR_DEFAULT, 0},
+         [HL_KEYWORD1] = {EDITOR_RGB(197, 134, 192), EDITOR_COLOR_DEFAULT, 0},
+         [HL_KEYWORD2] = {EDITOR_RGB(78, 201, 176), EDITOR_COLOR_DEFAULT, 0},
+         [HL_STRING] = {EDITOR_RGB(206, 145, 120), EDITOR_COLOR_DEFAULT, 0},
+         [HL_NUMBER] = {EDITOR_RGB(181, 206, 168), EDITOR_COLOR_DEFAULT, 0},
+         [HL_MATCH] = {EDITOR_RGB(20, 20, 20), EDITOR_RGB(255, 200, 0), STYLE_UNDERLINE},
+         [HL_BRACKET] = {EDITOR_COLOR_DEFAULT, EDITOR_RGB(80, 80, 80), STYLE_BOLD},
+         [HL_SELECTION] = {EDITOR_COLOR_DEFAULT, EDITOR_RGB(38, 79, 120), 0},
+     }},
+};
+
+#define THEME_ENTRIES (sizeof(themes) / sizeof(themes[0]))
+
+const struct editorStyle editorStyleDefault = {EDITOR_COLOR_DEFAULT, EDITOR_COLOR_DEFAULT, 0};
+
+const struct editorTheme *editorThemeDefault(void) {
+  return &themes[0];
+}
+
+// Switches to the built-in theme called `name`. Returns -1 if there is none.
+int editorThemeSet(struct editorConfig *E, const char *name) {
+  for (unsigned int j = 0; j < THEME_ENTRIES; j++) {
+    if (!strcmp(themes[j].name, name)) {
+      E->theme = &themes[j];
+      E->relayout = 1;  // Repaint every window in the new colours
+      return 0;
+    }
+  }
+  return -1;
+}
+
+/*** graphic rendition ***/
+
+// Appends the SGR parameters selecting colour `color` as foreground (`base` 30) or background
+// (`base` 40): the short codes for the 16 ANSI colours, then 256-colour and 24-bit forms
+static int sgrColor(char *buf, int base, int color) {
+  if (color == EDITOR_COLOR_DEFAULT) return sprintf(buf, ";%d", base + 9);
+  if (color < 8) return sprintf(buf, ";%d", base + color);
+  if (color < 16) return sprintf(buf, ";%d", base + 60 + color - 8);
+  if (color < 256) return sprintf(buf, ";%d;5;%d", base + 8, color);
+  return sprintf(buf, ";%d;2;%d;%d;%d", base + 8, (color >> 16) & 0xff, (color >> 8) & 0xff, color & 0xff);
+}
+
+// The parameters that change `from` into `to`, each preceded by `;`
+static int sgrDiff(char *buf, const struct editorStyle *from, const struct editorStyle *to) {
+  static const struct {
+    int flag, on, off;
+  } attrs[] = {{STYLE_BOLD, 1, 22}, {STYLE_UNDERLINE, 4, 24}, {STYLE_INVERSE, 7, 27}};
+
+  int len = 0;
+  for (unsigned int j = 0; j < sizeof(attrs) / sizeof(attrs[0]); j++) {
+    if ((from->attrs ^ to->attrs) & attrs[j].flag) {
+      len += sprintf(buf + len, ";%d", to->attrs & attrs[j].flag ? attrs[j].on : attrs[j].off);
+    }
+  }
+  if (from->fg != to->fg) len += sgrColor(buf + len, 30, to->fg);
+  if (from->bg != to->bg) len += sgrColor(buf + len, 40, to->bg);
+  return len;
+}
+
+// Appends the shortest SGR sequence that changes the terminal's rendition from `from` to `to`:
+// only what differs, or a reset followed by what `to` sets when that is shorter. Nothing is
+// appended if they are the same.
+void editorStyleApply(struct abuf *ab, const struct editorStyle *from, const struct editorStyle *to) {
+  char diff[80], reset[80];
+  int dlen = sgrDiff(diff, from, to);
+  if (dlen == 0) return;
+
+  // `ESC [ m` alone, or `ESC [ 0 ; ...`, starts from the default rendition
+  int rlen = sgrDiff(reset, &editorStyleDefault, to);
+  int reset_len = rlen ? rlen + 4 : 3;
+
+  char buf[88];
+  int len;
+  if (reset_len < dlen + 2) {
+    len = snprintf(buf, sizeof(buf), "\x1b[%s%sm", rlen ? "0" : "", rlen ? reset : "");
+  } else {
+    len = snprintf(buf, sizeof(buf), "\x1b[%sm", diff + 1);
+  }
+  abAppend(ab, buf, len);
+}
@@ -0,0 +1,104 @@
+/*** includes ***/
+
+// Feature test macros (portability): https://www.gnu.org/software/libc/manual/html_node/Feature-Test-Macros.html
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "editor.h"
+
+/*** trace ***/
+
+// Spans are recorded only when `EDITOR_TRACE=path` is set, and written on exit as Chrome
+// `trace_event` JSON (load the file in Perfetto or chrome://tracing)
+
+struct traceEvent {
+  const char *name;
+  long long ts;            // Microseconds since the trace started
+  int tid;
+  char phase;              // 'B' (begin) or 'E' (end)
+  volatile int committed;  // Set last, so the flush skips slots still being written
+};
+
+struct traceRing {
+  struct traceEvent *events;
+  unsigned long head;  // Total events claimed; slot is `head % EDITOR_TRACE_EVENTS`
+  long long start;
+  char *path;
+};
+
+static struct traceRing T;
+
+static long long traceNow(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int traceThreadId(void) {
+  static int next_tid = 0;
+  static __thread int tid = 0;
+  if (tid == 0) tid = __atomic_add_fetch(&next_tid, 1, __ATOMIC_RELAXED);
+  return tid;
+}
+
+void traceRecord(const char *name, char phase) {
+  if (T.events == NULL) return;
+
+  // Claiming a slot is a single atomic increment; writers never wait on each other or the flush
+  unsigned long n = __atomic_fetch_add(&T.head, 1, __ATOMIC_RELAXED);
+  struct traceEvent *ev = &T.events[n & (EDITOR_TRACE_EVENTS - 1)];
+
+  __atomic_store_n(&ev->committed, 0, __ATOMIC_RELAXED);
+  ev->name = name;
+  ev->ts = traceNow() - T.start;
+  ev->tid = traceThreadId();
+  ev->phase = phase;
+  __atomic_store_n(&ev->committed, 1, __ATOMIC_RELEASE);
+}
+
+void traceFlush(void) {
+  if (T.events == NULL) return;
+
+  FILE *fp = fopen(T.path, "w");
+  if (fp) {
+    unsigned long head = __atomic_load_n(&T.head, __ATOMIC_ACQUIRE);
+    // Once the ring has wrapped, only the newest `EDITOR_TRACE_EVENTS` events survive
+    unsigned long first = head > EDITOR_TRACE_EVENTS ? head - EDITOR_TRACE_EVENTS : 0;
+    int pid = getpid();
+    int sep = 0;
+
+    fprintf(fp, "{\"traceEvents\":[\n");
+    for (unsigned long n = first; n < head; n++) {
+      struct traceEvent *ev = &T.events[n & (EDITOR_TRACE_EVENTS - 1)];
+      if (!__atomic_load_n(&ev->committed, __ATOMIC_ACQUIRE)) continue;
+
+      fprintf(fp, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%lld,\"pid\":%d,\"tid\":%d}",
+              sep ? ",\n" : "", ev->name, ev->phase, ev->ts, pid, ev->tid);
+      sep = 1;
+    }
+    fprintf(fp, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    fclose(fp);
+  }
+
+  free(T.events);
+  T.events = NULL;
+}
+
+void traceInit(void) {
+  char *path = getenv("EDITOR_TRACE");
+  if (path == NULL || path[0] == '\0') return;
+
+  T.events = calloc(EDITOR_TRACE_EVENTS, sizeof(struct traceEvent));
+  if (T.events == NULL) return;
+
+  T.path = path;
+  T.head = 0;
+  T.start = traceNow();
+  atexit(traceFlush);
+}
@@ -0,0 +1,511 @@
+/*** includes ***/
+
+// Feature test macros (portability): https://www.gnu.org/software/libc/manual/html_node/Feature-Test-Macros.html
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#include "editor.h"
+
+#ifdef __APPLE__
+#define st_mtim st_mtimespec
+#endif
+
+/*** watch ***/
+
+// Notices other processes writing a buffer's file. On Linux, inotify watches the file's
+// directory (so replacing the file by a rename is seen too); elsewhere files are `stat()`ed once
+// a second. A buffer without unsaved edits then follows the file: appends are read from the old
+// end of the file onwards, and anything else is diffed against the rows by line hash so only
+// the changed ranges are replaced. A buffer with unsaved edits is left alone, and saving it
+// over the changed file takes a second Ctrl-S. A followed buffer (`tail -f`) is read-only,
+// keeps views that were on its last row there, and starts over when its file is truncated or
+// rotated.
+
+#define WATCH_TAIL 4096          // Bytes hashed at the end of the file to recognise appends
+#define WATCH_RESYNC 1024        // How far apart, in lines, a diff looks for matching lines
+#define WATCH_POLL_SECONDS 1     // Without inotify, how often files are checked
+#define WATCH_CHUNK (64 * 1024)  // Bytes read at a time when appending
+
+// FNV-1a
+static uint64_t watchHash(const char *s, size_t len) {
+  uint64_t h = 14695981039346656037ull;
+  for (size_t j = 0; j < len; j++) {
+    h ^= (unsigned char)s[j];
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+void editorWatchInit(struct editorConfig *E) {
+#ifdef __linux__
+  E->watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#else
+  E->watch_fd = -1;
+#endif
+}
+
+void editorWatchFree(struct editorConfig *E) {
+  if (E->watch_fd != -1) close(E->watch_fd);
+  E->watch_fd = -1;
+}
+
+// Reads the last bytes of the file before `size`; returns how many were read
+static int watchReadTail(int fd, off_t size, char *tail) {
+  int len = size < WATCH_TAIL ? (int)size : WATCH_TAIL;
+  if (pread(fd, tail, len, size - len) != len) return -1;
+  return len;
+}
+
+// Remembers the file open on `fd` as `st` describes it, which may be older than its contents
+static void editorDiskRemember(struct editorBuffer *B, int fd, struct stat *st) {
+  struct editorDisk *D = &B->disk;
+
+  D->known = 1;
+  D->changed = 0;
+  D->dev = st->st_dev;
+  D->ino = st->st_ino;
+  D->size = st->st_size;
+  D->mtime = st->st_mtim.tv_sec;
+  D->mtime_nsec = st->st_mtim.tv_nsec;
+  D->tail_len = 0;
+  D->tail_hash = 0;
+  D->eol = 1;
+
+  // The tail of a compressed file says nothing about its text; those are always diffed
+  char tail[WATCH_TAIL];
+  int len = B->compression == COMPRESS_NONE ? watchReadTail(fd, st->st_size, tail) : -1;
+  if (len > 0) {
+    D->tail_len = len;
+    D->tail_hash = watchHash(tail, len);
+    D->eol = tail[len - 1] == '\n';
+  }
+}
+
+// Remembers the file as it is now, once the buffer matches it (after a load or save)
+void editorDiskRecord(struct editorBuffer *B) {
+  struct stat st;
+  int fd = B->filename ? open(B->filename, O_RDONLY) : -1;
+
+  B->disk.known = 0;
+  B->disk.changed = 0;
+  if (fd == -1) return;
+  if (fstat(fd, &st) == 0) editorDiskRemember(B, fd, &st);
+  close(fd);
+}
+
+// Non-zero if the file is no longer the one the buffer last matched
+int editorDiskChanged(struct editorBuffer *B) {
+  struct editorDisk *D = &B->disk;
+  struct stat st;
+
+  if (!D->known) return 0;
+  if (stat(B->filename, &st) == -1) return 0;  // Deleted: saving will simply recreate it
+  return st.st_dev != D->dev || st.st_ino != D->ino || st.st_size != D->size ||
+         st.st_mtim.tv_sec != D->mtime || st.st_mtim.tv_nsec != D->mtime_nsec;
+}
+
+// Stops watching the directory of a buffer that is being closed or renamed, unless another buffer
+// needs it
+void editorWatchRemove(struct editorConfig *E, struct editorBuffer *B) {
+#ifdef __linux__
+  if (E->watch_fd == -1 || B->disk.wd <= 0) return;
+  for (int j = 0; j < E->numbuffers; j++) {
+    if (E->buffers[j] != B && E->buffers[j]->disk.wd == B->disk.wd) return;
+  }
+  inotify_rm_watch(E->watch_fd, B->disk.wd);
+#else
+  (void)E;
+  (void)B;
+#endif
+}
+
+static void editorWatchAdd(struct editorConfig *E, struct editorBuffer *B) {
+  B->disk.wd = -1;
+#ifdef __linux__
+  if (E->watch_fd == -1) return;
+
+  const char *slash = strrchr(B->filename, '/');
+  char *dir = slash ? strndup(B->filename, slash - B->filename + 1) : strdup(".");
+  B->disk.wd = inotify_add_watch(E->watch_fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_MODIFY | IN_CREATE);
+  free(dir);
+#else
+  (void)E;
+#endif
+}
+
+// Flags the buffers whose files inotify reported as written or replaced
+static void editorWatchRead(struct editorConfig *E) {
+#ifdef __linux__
+  char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  ssize_t len;
+
+  while (E->watch_fd != -1 && (len = read(E->watch_fd, events, sizeof(events))) > 0) {
+    for (char *p = events; p < events + len;) {
+      struct inotify_event *ev = (struct inotify_event *)p;
+
+      for (int j = 0; ev->len && j < E->numbuffers; j++) {
+        struct editorBuffer *B = E->buffers[j];
+        if (B->filename == NULL || B->disk.wd != ev->wd) continue;
+
+        const char *slash = strrchr(B->filename, '/');
+        if (!strcmp(slash ? slash + 1 : B->filename, ev->name)) B->disk.event = 1;
+      }
+      p += sizeof(struct inotify_event) + ev->len;
+    }
+  }
+#else
+  (void)E;
+#endif
+}
+
+// Splits bytes `from` to `to` of the file into rows at the end of the buffer; with `continued`,
+// the first line carries on the buffer's last row. Lines are counted a chunk at a time so the
+// row array grows once per chunk.
+static void editorReadRows(struct editorBuffer *B, int fd, off_t from, off_t to, int continued) {
+  struct abuf line = ABUF_INIT;
+  char *chunk = malloc(WATCH_CHUNK);
+  off_t off = from;
+
+  while (off < to) {
+    size_t want = to - off < WATCH_CHUNK ? to - off : WATCH_CHUNK;
+    ssize_t n = pread(fd, chunk, want, off);
+    if (n <= 0) break;
+    off += n;
+
+    char *p = chunk;
+    char *end = chunk + n;
+    char *nl;
+    int lines = 0;
+    for (char *q = p; (q = memchr(q, '\n', end - q)) != NULL; q++) lines++;
+    editorRowsReserve(B, B->numrows + lines + 1);
+
+    while ((nl = memchr(p, '\n', end - p)) != NULL) {
+      abAppend(&line, p, nl - p);
+      int len = line.len;
+      while (len > 0 && line.b[len - 1] == '\r') len--;
+
+      if (continued) {
+        erow *row = &B->row[B->numrows - 1];
+        if (len > 0) editorRowAppendString(B, row, line.b, len);
+        // A `\r\n` split between reloads left its `\r` on the row
+        int size = row->size;
+        while (size > 0 && row->chars[size - 1] == '\r') size--;
+        editorRowTruncate(B, row, size);
+        continued = 0;
+      } else {
+        editorInsertRow(B, B->numrows, line.b, len);
+      }
+      line.len = 0;
+      p = nl + 1;
+    }
+    abAppend(&line, p, end - p);
+  }
+
+  // A last line without its newline yet; the rest of it is appended when it arrives
+  if (line.len > 0) {
+    if (continued) {
+      editorRowAppendString(B, &B->row[B->numrows - 1], line.b, line.len);
+    } else {
+      editorInsertRow(B, B->numrows, line.b, line.len);
+    }
+  }
+
+  abFree(&line);
+  free(chunk);
+}
+
+// Appends what was written after the old end of the file. Returns -1, having changed nothing,
+// if the file did anything but grow.
+static int editorReloadAppend(struct editorBuffer *B, int fd, struct stat *st) {
+  struct editorDisk *D = &B->disk;
+  if (B->compression != COMPRESS_NONE || st->st_dev != D->dev || st->st_ino != D->ino ||
+      st->st_size <= D->size || D->tail_len == 0) {
+    return -1;
+  }
+
+  char tail[WATCH_TAIL];
+  if (watchReadTail(fd, D->size, tail) != D->tail_len || watchHash(tail, D->tail_len) != D->tail_hash)
+    return -1;
+
+  editorReadRows(B, fd, D->size, st->st_size, !D->eol && B->numrows > 0);
+  return 0;
+}
+
+// Replaces every row with the file's lines, e.g. when a followed log was truncated or rotated
+// and the old rows have nothing in common with it
+static void editorReloadReplace(struct editorConfig *E, struct editorBuffer *B, int fd,
+                                struct stat *st) {
+  int before = B->numrows;
+  editorHighlighterFinish(B);  // Its threads may still be reading the rows
+  editorBracketsInvalidate(B);
+  editorClipboardTouch(B, 0);
+  for (int j = 0; j < B->numrows; j++) editorFreeRow(B, &B->row[j]);
+  B->numrows = 0;
+  B->version++;
+  editorLinesChanged(B, 0);
+  editorWindowsShiftRows(E, B, 0, before, 0);
+
+  editorReadRows(B, fd, 0, st->st_size, 0);
+}
+
+// Whether `row`, with hash `h`, holds new line `j`
+static int watchSame(erow *row, uint64_t h, uint64_t *nh, const char *text, size_t *offsets, int j) {
+  return h == nh[j] && (size_t)row->size == offsets[j + 1] - offsets[j] &&
+         !memcmp(row->chars, &text[offsets[j]], row->size);
+}
+
+// Reads the whole file and replaces only the ranges of rows that differ from its lines.
+// Returns the number of rows removed or inserted, or -1 if the file can't be read.
+static int editorReloadDiff(struct editorConfig *E, struct editorBuffer *B, int fd) {
+  FILE *fp = fdopen(dup(fd), "r");
+  if (fp == NULL) return -1;
+  struct editorReader *R = editorReaderOpen(fp);
+  if (R == NULL) return -1;
+
+  // The new lines, back to back, with their hashes; `size_t` offsets, as files may pass 2 GiB
+  char *text = NULL;
+  size_t text_len = 0, text_cap = 0;
+  size_t *offsets = malloc(sizeof(size_t) * 16);
+  uint64_t *nh = malloc(sizeof(uint64_t) * 16);
+  int m = 0, cap = 16;
+  char *line;
+  ssize_t len;
+
+  offsets[0] = 0;
+  while ((len = editorReaderLine(R, &line)) != -1) {
+    if (m + 1 == cap) {
+      cap *= 2;
+      offsets = realloc(offsets, sizeof(size_t) * cap);
+      nh = realloc(nh, sizeof(uint64_t) * cap);
+    }
+    if (text_len + len > text_cap) {
+      while (text_len + len > text_cap) text_cap = text_cap ? text_cap * 2 : 4096;
+      text = realloc(text, text_cap);
+    }
+    memcpy(&text[text_len], line, len);
+    text_len += len;
+    nh[m] = watchHash(line, len);
+    offsets[++m] = text_len;
+  }
+  editorReaderClose(R);
+
+  int n = B->numrows;
+  uint64_t *oh = malloc(sizeof(uint64_t) * (n ? n : 1));
+  for (int i = 0; i < n; i++) oh[i] = watchHash(B->row[i].chars, B->row[i].size);
+
+  // Common prefix and suffix, then matching lines found by looking ahead in both files
+  int prefix = 0;
+  while (prefix < n && prefix < m &&
+         watchSame(&B->row[prefix], oh[prefix], nh, text, offsets, prefix)) {
+    prefix++;
+  }
+  int suffix = 0;
+  while (suffix < n - prefix && suffix < m - prefix &&
+         watchSame(&B->row[n - 1 - suffix], oh[n - 1 - suffix], nh, text, offsets, m - 1 - suffix)) {
+    suffix++;
+  }
+
+  if (prefix + suffix == n && n == m) {
+    free(oh);
+    free(nh);
+    free(offsets);
+    free(text);
+    return 0;
+  }
+
+  // The row array is rebuilt once: kept rows move across, and each changed range is freed or
+  // made from the new lines, so rewriting the whole file costs no more than rewriting one line.
+  // A row's new position is always `j`. Not journalled: a reload is not an edit.
+  editorHighlighterFinish(B);
+  editorClipboardTouch(B, prefix);
+  editorBracketsInvalidate(B);
+  erow *rows = malloc(sizeof(erow) * (m ? m : 1));
+  signed char *incoming = malloc(m ? m : 1);  // Comment state a kept row was highlighted after; -1 if new
+  int i = 0, j = 0, changes = 0;
+  while (i < n || j < m) {
+    if (i < n && j < m && (i < prefix || i >= n - suffix || watchSame(&B->row[i], oh[i], nh, text, offsets, j))) {
+      rows[j] = B->row[i];
+      rows[j].idx = j;
+      incoming[j] = i > 0 && B->row[i - 1].hl_open_comment;
+      i++;
+      j++;
+      continue;
+    }
+
+    // The nearest pair of matching lines, `a` old and `b` new lines ahead
+    int a = n - suffix - i, b = m - suffix - j;
+    for (int d = 1; d <= WATCH_RESYNC && d < a + b; d++) {
+      int found = 0;
+      for (int x = 0; x <= d; x++) {
+        if (i + x < n - suffix && j + d - x < m - suffix && oh[i + x] == nh[j + d - x]) {
+          a = x;
+          b = d - x;
+          found = 1;
+          break;
+        }
+      }
+      if (found) break;
+    }
+
+    for (int k = 0; k < a; k++) editorFreeRow(B, &B->row[i + k]);
+    for (int k = 0; k < b; k++) {
+      erow *row = &rows[j + k];
+      memset(row, 0, sizeof(erow));
+      row->idx = j + k;
+      row->size = offsets[j + k + 1] - offsets[j + k];
+      row->chars = poolAlloc(B->pool, row->size + 1);
+      memcpy(row->chars, &text[offsets[j + k]], row->size);
+      row->chars[row->size] = '\0';
+      incoming[j + k] = -1;
+    }
+
+    editorWindowsShiftRows(E, B, j, a, b);
+    changes += a + b;
+    i += a;
+    j += b;
+  }
+  free(B->row);
+  B->row = rows;
+  B->rowcap = m ? m : 1;
+  B->numrows = m;
+
+  // New rows, and kept rows now below a different comment state, are highlighted in one pass
+  int in_comment = 0;
+  for (int y = 0; y < m; y++) {
+    erow *row = &B->row[y];
+    if (incoming[y] != in_comment) {
+      if (row->render == NULL) editorRenderRow(B->pool, row);  // New, or evicted
+      row->hl_open_comment = editorHighlightRow(B->pool, B->syntax, row, in_comment);
+    }
+    in_comment = row->hl_open_comment;
+  }
+  free(incoming);
+
+  B->dirty++;
+  B->version++;
+  editorLinesChanged(B, prefix);
+
+  free(oh);
+  free(nh);
+  free(offsets);
+  free(text);
+  return changes;
+}
+
+// Brings buffers without unsaved edits up to date with their files. Returns non-zero if the
+// screen needs to be refreshed.
+int editorWatchPoll(struct editorConfig *E) {
+  int refresh = 0;
+  time_t now = time(NULL);
+
+  editorWatchRead(E);
+
+  for (int j = 0; j < E->numbuffers; j++) {
+    struct editorBuffer *B = E->buffers[j];
+    struct editorDisk *D = &B->disk;
+    if (!D->known || B->loader || B->saver) continue;
+
+    if (D->wd == 0) {
+      editorWatchAdd(E, B);  // First look at this file: it may have changed before the watch
+      D->event = 1;
+    }
+    if (D->wd == -1 && now - D->checked >= WATCH_POLL_SECONDS) {
+      D->checked = now;
+      D->event = 1;
+    }
+    if (!D->event) continue;
+
+    D->event = 0;
+    if (!editorDiskChanged(B)) continue;
+
+    if (B->dirty) {
+      if (D->changed == 0) {
+        D->changed = 1;
+        editorSetStatusMessage(E, "%.20s changed on disk; saving will ask before overwriting it",
+                               B->filename);
+        refresh = 1;
+      }
+      continue;
+    }
+
+    struct stat st;
+    int fd = open(B->filename, O_RDONLY);
+    if (fd == -1) continue;
+    if (fstat(fd, &st) == -1) {
+      close(fd);
+      continue;
+    }
+
+    // Whatever is written while this runs shows up as a change to `st` and is read next time
+    TRACE_BEGIN("editorWatchReload");
+    int before = B->numrows;
+    B->journal.suspended++;  // Following the file is not an edit
+    if (editorReloadAppend(B, fd, &st) == 0) {
+      if (B->follow) {
+        editorWindowsFollow(E, B, before);
+      } else {
+        editorSetStatusMessage(E, "%.20s grew by %d lines", B->filename, B->numrows - before);
+      }
+    } else if (B->follow) {
+      // Truncated (`copytruncate`) or replaced by a new file (rotation): start again from the top
+      editorReloadReplace(E, B, fd, &st);
+      editorWindowsFollow(E, B, 0);
+      editorSetStatusMessage(E, "%.20s was truncated or rotated; following the new file", B->filename);
+    } else {
+      int changes = editorReloadDiff(E, B, fd);
+      if (changes > 0) editorSetStatusMessage(E, "Reloaded %.20s (%d lines changed)", B->filename, changes);
+    }
+    B->journal.suspended--;
+    TRACE_END("editorWatchReload");
+
+    B->dirty = 0;
+    editorDiskRemember(B, fd, &st);
+    close(fd);
+    refresh = 1;
+  }
+
+  return refresh;
+}
+
+// Starts or stops following the current buffer's file like `tail -f`. Returns -1 if it can't be
+// followed.
+int editorFollow(struct editorConfig *E, int on) {
+  struct editorBuffer *B = E->buf;
+
+  if (!on) {
+    B->follow = 0;
+    editorSetStatusMessage(E, "Stopped following %.20s", B->filename ? B->filename : "[No Name]");
+    return 0;
+  }
+
+  if (B->pager) {
+    editorSetStatusMessage(E, "Files opened with -R can't be followed");
+    return -1;
+  }
+  if (B->filename == NULL || !B->disk.known || B->compression != COMPRESS_NONE) {
+    editorSetStatusMessage(E, "Only uncompressed files on disk can be followed");
+    return -1;
+  }
+  if (B->dirty || B->loader) {
+    editorSetStatusMessage(E, "Save the buffer or wait for it to load before following it");
+    return -1;
+  }
+
+  B->follow = 1;
+  B->disk.event = 1;  // Catch up with anything written since the last look
+  B->cy = B->numrows > 0 ? B->numrows - 1 : 0;
+  editorSetStatusMessage(E, "Following %.20s (Ctrl-T to stop)", B->filename);
+  return 0;
+}
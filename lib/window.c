@@ -0,0 +1,253 @@
+/*** includes ***/
+
+#include <stdlib.h>
+
+#include "editor.h"
+
+/*** windows ***/
+
+#define WINDOW_MIN_ROWS 2
+#define WINDOW_MIN_COLS 8
+
+static struct editorLayout *editorLayoutLeaf(struct editorWindow *W) {
+  struct editorLayout *node = calloc(1, sizeof(struct editorLayout));
+  node->win = W;
+  return node;
+}
+
+static struct editorLayout *editorLayoutFind(struct editorLayout *node, struct editorWindow *W) {
+  if (node == NULL) return NULL;
+  if (node->split == 0) return node->win == W ? node : NULL;
+
+  struct editorLayout *found = editorLayoutFind(node->a, W);
+  return found ? found : editorLayoutFind(node->b, W);
+}
+
+static void editorLayoutFree(struct editorLayout *node) {
+  if (node == NULL) return;
+  editorLayoutFree(node->a);
+  editorLayoutFree(node->b);
+  free(node->win);
+  free(node);
+}
+
+void editorWindowsInit(struct editorConfig *E) {
+  struct editorWindow *W = calloc(1, sizeof(struct editorWindow));
+  W->buf = E->buf;
+
+  E->layout = editorLayoutLeaf(W);
+  E->win = W;
+  E->relayout = 1;
+}
+
+void editorWindowsFree(struct editorConfig *E) {
+  editorLayoutFree(E->layout);
+  E->layout = NULL;
+  E->win = NULL;
+}
+
+// Copies the active view out of the buffer into its window
+void editorWindowStore(struct editorWindow *W) {
+  struct editorBuffer *B = W->buf;
+  W->cx = B->cx;
+  W->cy = B->cy;
+  W->rx = B->rx;
+  W->rowoff = B->rowoff;
+  W->coloff = B->coloff;
+}
+
+// Makes the window's view the buffer's current one, before it gets focus
+void editorWindowLoad(struct editorWindow *W) {
+  struct editorBuffer *B = W->buf;
+  B->cx = W->cx;
+  B->cy = W->cy;
+  B->rx = W->rx;
+  B->rowoff = W->rowoff;
+  B->coloff = W->coloff;
+}
+
+// Fills `out` with up to `n` windows in screen order (top to bottom, left to right)
+int editorWindowsCollect(struct editorLayout *node, struct editorWindow **out, int n) {
+  if (node == NULL || n <= 0) return 0;
+  if (node->split == 0) {
+    out[0] = node->win;
+    return 1;
+  }
+
+  int count = editorWindowsCollect(node->a, out, n);
+  return count + editorWindowsCollect(node->b, out + count, n - count);
+}
+
+static void editorLayoutPlace(struct editorConfig *E, struct editorLayout *node, int top, int left,
+                              int rows, int cols) {
+  if (node->split == 0) {
+    struct editorWindow *W = node->win;
+    // Windows that don't reach the bottom bars get a status line of their own
+    W->statusline = (top + rows < E->screenrows);
+    W->top = top;
+    W->left = left;
+    W->rows = rows - W->statusline;
+    W->cols = cols;
+    W->drawn = 0;
+  } else if (node->split == 'h') {
+    int arows = rows / 2;
+    editorLayoutPlace(E, node->a, top, left, arows, cols);
+    editorLayoutPlace(E, node->b, top + arows, left, rows - arows, cols);
+  } else {
+    int acols = (cols - 1) / 2;  // One column is the separator
+    editorLayoutPlace(E, node->a, top, left, rows, acols);
+    editorLayoutPlace(E, node->b, top, left + acols + 1, rows, cols - acols - 1);
+  }
+}
+
+void editorWindowsLayout(struct editorConfig *E) {
+  editorLayoutPlace(E, E->layout, 0, 0, E->screenrows, E->screencols);
+  E->relayout = 0;
+}
+
+// Splits the active window in two views of the same buffer; the new one gets focus
+int editorWindowSplit(struct editorConfig *E, char split) {
+  if (E->relayout) editorWindowsLayout(E);
+
+  struct editorWindow *W = E->win;
+  struct editorWindow *wins[EDITOR_MAX_WINDOWS];
+  if (editorWindowsCollect(E->layout, wins, EDITOR_MAX_WINDOWS) == EDITOR_MAX_WINDOWS) return -1;
+  if (split == 'h' && W->rows + W->statusline < 2 * (WINDOW_MIN_ROWS + 1)) return -1;
+  if (split == 'v' && W->cols < 2 * WINDOW_MIN_COLS + 1) return -1;
+
+  struct editorLayout *leaf = editorLayoutFind(E->layout, W);
+  struct editorWindow *N = calloc(1, sizeof(struct editorWindow));
+  N->buf = W->buf;
+
+  // The leaf becomes the split node, with the old window first and the new one second
+  leaf->split = split;
+  leaf->win = NULL;
+  leaf->a = editorLayoutLeaf(W);
+  leaf->b = editorLayoutLeaf(N);
+  leaf->a->parent = leaf->b->parent = leaf;
+
+  editorWindowStore(W);
+  N->cx = W->cx;
+  N->cy = W->cy;
+  N->rowoff = W->rowoff;
+  N->coloff = W->coloff;
+
+  E->win = N;  // Same buffer, same view: nothing to load
+  E->relayout = 1;
+  return 0;
+}
+
+// Closes the active window and gives its space to its sibling; the last window stays open
+void editorWindowClose(struct editorConfig *E) {
+  struct editorLayout *leaf = editorLayoutFind(E->layout, E->win);
+  struct editorLayout *parent = leaf->parent;
+  if (parent == NULL) return;
+
+  struct editorLayout *sibling = parent->a == leaf ? parent->b : parent->a;
+
+  free(E->win);
+  free(leaf);
+
+  // The sibling subtree takes the parent's place in the tree
+  *parent = (struct editorLayout){.split = sibling->split,
+                                  .parent = parent->parent,
+                                  .a = sibling->a,
+                                  .b = sibling->b,
+                                  .win = sibling->win};
+  if (parent->a) parent->a->parent = parent;
+  if (parent->b) parent->b->parent = parent;
+  free(sibling);
+
+  struct editorWindow *next;
+  editorWindowsCollect(parent, &next, 1);
+
+  E->win = NULL;
+  editorWindowFocus(E, next);
+  E->relayout = 1;
+}
+
+void editorWindowFocus(struct editorConfig *E, struct editorWindow *W) {
+  if (W == E->win) return;
+  if (E->win) editorWindowStore(E->win);
+
+  E->win = W;
+  editorWindowLoad(W);
+
+  for (int j = 0; j < E->numbuffers; j++) {
+    if (E->buffers[j] == W->buf) {
+      E->current = j;
+      E->buf = W->buf;
+    }
+  }
+}
+
+void editorWindowNext(struct editorConfig *E) {
+  struct editorWindow *wins[EDITOR_MAX_WINDOWS];
+  int n = editorWindowsCollect(E->layout, wins, EDITOR_MAX_WINDOWS);
+
+  for (int j = 0; j < n; j++) {
+    if (wins[j] == E->win) {
+      editorWindowFocus(E, wins[(j + 1) % n]);
+      return;
+    }
+  }
+}
+
+int editorBufferVisible(struct editorConfig *E, struct editorBuffer *B) {
+  struct editorWindow *wins[EDITOR_MAX_WINDOWS];
+  int n = editorWindowsCollect(E->layout, wins, EDITOR_MAX_WINDOWS);
+
+  for (int j = 0; j < n; j++) {
+    if (wins[j]->buf == B) return 1;
+  }
+  return 0;
+}
+
+// Points every window showing `from` at `to`, e.g. before `from` is closed
+void editorWindowsReplaceBuffer(struct editorConfig *E, struct editorBuffer *from, struct editorBuffer *to) {
+  struct editorWindow *wins[EDITOR_MAX_WINDOWS];
+  int n = editorWindowsCollect(E->layout, wins, EDITOR_MAX_WINDOWS);
+
+  for (int j = 0; j < n; j++) {
+    if (wins[j]->buf != from) continue;
+    wins[j]->buf = to;
+    wins[j]->cx = wins[j]->cy = wins[j]->rx = wins[j]->rowoff = wins[j]->coloff = 0;
+  }
+}
+
+static void editorShiftRow(int *y, int at, int removed, int inserted) {
+  if (*y >= at + removed) {
+    *y += inserted - removed;
+  } else if (*y >= at) {
+    *y = at;
+  }
+}
+
+// Keeps every view of `B` on the same text after `removed` rows at `at` were replaced by
+// `inserted` others, e.g. when the file is reloaded from disk
+void editorWindowsShiftRows(struct editorConfig *E, struct editorBuffer *B, int at, int removed,
+                            int inserted) {
+  struct editorWindow *wins[EDITOR_MAX_WINDOWS];
+  int n = editorWindowsCollect(E->layout, wins, EDITOR_MAX_WINDOWS);
+
+  editorShiftRow(&B->cy, at, removed, inserted);
+  editorShiftRow(&B->rowoff, at, removed, inserted);
+  for (int j = 0; j < n; j++) {
+    if (wins[j]->buf != B || wins[j] == E->win) continue;  // The active view lives in the buffer
+    editorShiftRow(&wins[j]->cy, at, removed, inserted);
+    editorShiftRow(&wins[j]->rowoff, at, removed, inserted);
+  }
+}
+
+// Moves the views of `B` that were on its last row (out of `oldrows`) to its new last row
+void editorWindowsFollow(struct editorConfig *E, struct editorBuffer *B, int oldrows) {
+  struct editorWindow *wins[EDITOR_MAX_WINDOWS];
+  int n = editorWindowsCollect(E->layout, wins, EDITOR_MAX_WINDOWS);
+  int last = B->numrows > 0 ? B->numrows - 1 : 0;
+
+  if (B->cy >= oldrows - 1) B->cy = last;
+  for (int j = 0; j < n; j++) {
+    if (wins[j]->buf != B || wins[j] == E->win) continue;  // The active view lives in the buffer
+    if (wins[j]->cy >= oldrows - 1) wins[j]->cy = last;
+  }
+}